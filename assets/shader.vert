@@ -1,16 +1,23 @@
 #version 460 core
 
 layout(location = 0) in vec2 coords;
-layout(location = 1) in mat4 model;
-layout(location = 5) in vec4 i_color;
+layout(location = 1) in vec4 boid;
+layout(location = 2) in uint group;
 
 out vec4 color;
 out vec3 pos;
 
 uniform mat4 projection;
+uniform float boid_size;
+uniform vec4 palette[4];
 
 void main() {
-	color = i_color;
-	gl_Position = projection * model * vec4(coords, 0.0f, 1.0f);
+	// boid holds the position in xy and the velocity in zw. The triangle
+	// points up, so it is turned a quarter past the heading.
+	vec2 heading = length(boid.zw) > 0.0f ? normalize(boid.zw) : vec2(1.0f, 0.0f);
+	mat2 rotation = mat2(-heading.y, heading.x, -heading.x, -heading.y);
+
+	color = palette[group];
+	gl_Position = projection * vec4(boid.xy + boid_size * (rotation * coords), 0.0f, 1.0f);
 	pos = gl_Position.xyz;
 }
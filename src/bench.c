@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "spatial.h"
+#include "profiler.h"
+#include "rng.h"
+
+#define BENCH_WIDTH 1280.0f
+#define BENCH_HEIGHT 720.0f
+#define BENCH_RANGE 40.0f
+#define BENCH_BUILDS 5
+#define BENCH_QUERIES 10000
+#define BENCH_SEED 1
+#define BENCH_FLOCKS 8
+#define BENCH_SPEED 6.0f
+
+// Scenarios are generated from a fixed seed so every run measures the exact
+// same points.
+static uint64_t bench_key;
+
+static float bench_rand(int i, int draw) {
+	return rng_float(bench_key, i, 0, draw);
+}
+
+static void fill_uniform(float *x, float *y, int len) {
+	for (int i = 0; i < len; i++) {
+		x[i] = bench_rand(i, 0) * BENCH_WIDTH;
+		y[i] = bench_rand(i, 1) * BENCH_HEIGHT;
+	}
+}
+
+// The 200x200 square sim_spawn() fills at the start of every run.
+static void fill_cluster(float *x, float *y, int len) {
+	for (int i = 0; i < len; i++) {
+		x[i] = BENCH_WIDTH / 2 + 100 * (bench_rand(i, 0) * 2 - 1);
+		y[i] = BENCH_HEIGHT / 2 + 100 * (bench_rand(i, 1) * 2 - 1);
+	}
+}
+
+static void fill_ring(float *x, float *y, int len) {
+	for (int i = 0; i < len; i++) {
+		float a = bench_rand(i, 0) * 2 * M_PI;
+		float r = 250 + 20 * (bench_rand(i, 1) - 0.5f);
+
+		x[i] = BENCH_WIDTH / 2 + r * cosf(a);
+		y[i] = BENCH_HEIGHT / 2 + r * sinf(a);
+	}
+}
+
+static void fill_flocks(float *x, float *y, int len) {
+	float cx[BENCH_FLOCKS];
+	float cy[BENCH_FLOCKS];
+
+	for (int i = 0; i < BENCH_FLOCKS; i++) {
+		// Flock centers are drawn past the points' own draws.
+		cx[i] = 100 + bench_rand(i, 4) * (BENCH_WIDTH - 200);
+		cy[i] = 100 + bench_rand(i, 5) * (BENCH_HEIGHT - 200);
+	}
+
+	for (int i = 0; i < len; i++) {
+		int f = i % BENCH_FLOCKS;
+
+		// Sum of uniforms, denser towards the center of the flock.
+		x[i] = cx[f] + 30 * (bench_rand(i, 0) + bench_rand(i, 1) - 1);
+		y[i] = cy[f] + 30 * (bench_rand(i, 2) + bench_rand(i, 3) - 1);
+	}
+}
+
+struct Scenario {
+	const char *name;
+	void (*fill)(float *x, float *y, int len);
+};
+
+static const struct Scenario scenarios[] = {
+	{"uniform", fill_uniform},
+	{"cluster", fill_cluster},
+	{"ring", fill_ring},
+	{"flocks", fill_flocks},
+};
+
+static const int sizes[] = {1000, 10000, 100000, 1000000};
+
+#define LEN(a) (int)(sizeof(a) / sizeof((a)[0]))
+
+struct BenchResult {
+	uint64_t build_ns;
+	uint64_t update_ns;
+	double query_ns;
+	double visited;
+	double candidates;
+	struct SpatialStats stats;
+};
+
+static void count_candidates(const int *ids, const float *xs, const float *ys, int len, void *data) {
+	*(long *)data += len;
+}
+
+// Moves every point by up to BENCH_SPEED along each axis, in a direction of
+// its own that stays the same from one move to the next, like a boid
+// moving through a step.
+static void bench_move(float *x, float *y, int len) {
+	for (int i = 0; i < len; i++) {
+		x[i] = spatial_clamp(x[i] + BENCH_SPEED * (bench_rand(i, 6) * 2 - 1), BENCH_WIDTH);
+		y[i] = spatial_clamp(y[i] + BENCH_SPEED * (bench_rand(i, 7) * 2 - 1), BENCH_HEIGHT);
+	}
+}
+
+// Builds take the best of BENCH_BUILDS runs, each from scratch. Queries are
+// centered on BENCH_QUERIES points spread evenly over the item order.
+// Updates take the best of BENCH_BUILDS builds, each after moving the
+// points of the previous one, which an incremental index only has to
+// update. The moved points are kept in mx and my.
+static void bench_run(const struct SpatialIndex *index, const float *x, const float *y, float *mx, float *my, int len, struct BenchResult *res) {
+	index->init(len);
+
+	res->build_ns = UINT64_MAX;
+	for (int i = 0; i < BENCH_BUILDS; i++) {
+		if (index->invalidate != NULL) {
+			index->invalidate();
+		}
+
+		uint64_t start = prof_now();
+		index->build(x, y, len, BENCH_WIDTH, BENCH_HEIGHT, BENCH_RANGE);
+		uint64_t ns = prof_now() - start;
+
+		res->build_ns = ns < res->build_ns ? ns : res->build_ns;
+	}
+
+	index->stats(&res->stats);
+
+	int queries = len < BENCH_QUERIES ? len : BENCH_QUERIES;
+	long visited = 0;
+	long candidates = 0;
+
+	uint64_t start = prof_now();
+	for (int i = 0; i < queries; i++) {
+		int j = (long)i * len / queries;
+
+		visited += index->query_radius(spatial_clamp(x[j], BENCH_WIDTH), spatial_clamp(y[j], BENCH_HEIGHT),
+			BENCH_RANGE, count_candidates, &candidates);
+	}
+	uint64_t ns = prof_now() - start;
+
+	res->query_ns = (double)ns / queries;
+	res->visited = (double)visited / queries;
+	res->candidates = (double)candidates / queries;
+
+	memcpy(mx, x, len * sizeof(float));
+	memcpy(my, y, len * sizeof(float));
+
+	res->update_ns = UINT64_MAX;
+	for (int i = 0; i < BENCH_BUILDS; i++) {
+		bench_move(mx, my, len);
+
+		uint64_t start = prof_now();
+		index->build(mx, my, len, BENCH_WIDTH, BENCH_HEIGHT, BENCH_RANGE);
+		uint64_t ns = prof_now() - start;
+
+		res->update_ns = ns < res->update_ns ? ns : res->update_ns;
+	}
+
+	index->free();
+}
+
+int main(int argc, char **argv) {
+	bool json = false;
+	const struct SpatialIndex *only_index = NULL;
+	const char *only_scenario = NULL;
+	int only_size = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+			only_index = spatial_find(argv[++i]);
+			if (only_index == NULL) {
+				fprintf(stderr, "unknown spatial index: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+			only_scenario = argv[++i];
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			only_size = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--json] [--index quadtree|quadtree-inc|grid] [--scenario uniform|cluster|ring|flocks] [-n POINTS]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	int max_size = only_size > 0 ? only_size : sizes[LEN(sizes) - 1];
+	float *x = calloc(max_size, sizeof(float));
+	float *y = calloc(max_size, sizeof(float));
+	float *mx = calloc(max_size, sizeof(float));
+	float *my = calloc(max_size, sizeof(float));
+	if (x == NULL || y == NULL || mx == NULL || my == NULL) {
+		fprintf(stderr, "Error while allocating points");
+		abort();
+	}
+
+	if (json) {
+		printf("{\"width\":%.0f,\"height\":%.0f,\"range\":%.0f,\"results\":[", BENCH_WIDTH, BENCH_HEIGHT, BENCH_RANGE);
+	} else {
+		printf("%-8s %8s %-12s %10s %10s %10s %9s %11s %8s %9s\n",
+			"scenario", "points", "index", "build ms", "update ms", "query ns", "visited", "candidates", "nodes", "MB");
+	}
+
+	bool first = true;
+	bench_key = rng_key(BENCH_SEED);
+
+	for (int s = 0; s < LEN(scenarios); s++) {
+		if (only_scenario != NULL && strcmp(only_scenario, scenarios[s].name) != 0) {
+			continue;
+		}
+
+		for (int n = 0; n < LEN(sizes); n++) {
+			int len = only_size > 0 ? only_size : sizes[n];
+
+			scenarios[s].fill(x, y, len);
+
+			for (int i = 0; i < spatial_indices_len; i++) {
+				const struct SpatialIndex *index = spatial_indices[i];
+				struct BenchResult res;
+
+				if (only_index != NULL && only_index != index) {
+					continue;
+				}
+
+				bench_run(index, x, y, mx, my, len, &res);
+
+				if (json) {
+					printf("%s\n{\"scenario\":\"%s\",\"points\":%d,\"index\":\"%s\",\"build_ns\":%lu,\"update_ns\":%lu,"
+						"\"query_ns\":%.1f,\"visited\":%.2f,\"candidates\":%.2f,\"nodes\":%d,\"bytes\":%zu}",
+						first ? "" : ",", scenarios[s].name, len, index->name, (unsigned long)res.build_ns,
+						(unsigned long)res.update_ns, res.query_ns, res.visited, res.candidates, res.stats.nodes, res.stats.bytes);
+				} else {
+					printf("%-8s %8d %-12s %10.3f %10.3f %10.1f %9.2f %11.2f %8d %9.2f\n",
+						scenarios[s].name, len, index->name, res.build_ns / 1e6, res.update_ns / 1e6, res.query_ns,
+						res.visited, res.candidates, res.stats.nodes, res.stats.bytes / (1024.0 * 1024.0));
+				}
+
+				first = false;
+			}
+
+			if (only_size > 0) {
+				break;
+			}
+		}
+	}
+
+	if (json) {
+		printf("\n]}\n");
+	}
+
+	free(x);
+	free(y);
+	free(mx);
+	free(my);
+
+	return 0;
+}
@@ -0,0 +1,53 @@
+#include "gputimer.h"
+
+void gputimer_init(struct GpuTimer *t) {
+	glGenQueries(GPUTIMER_FRAMES * PROF_PHASES, &t->queries[0][0]);
+
+	for (int i = 0; i < GPUTIMER_FRAMES; i++) {
+		for (int j = 0; j < PROF_PHASES; j++) {
+			t->issued[i][j] = false;
+		}
+	}
+
+	t->frame = 0;
+}
+
+// Must be called once at the start of every frame. Moves on to the next set
+// of queries and records the results it holds from GPUTIMER_FRAMES frames
+// ago. A result that is still not available is dropped instead of waited on.
+void gputimer_collect(struct GpuTimer *t) {
+	t->frame = (t->frame + 1) % GPUTIMER_FRAMES;
+
+	for (int i = 0; i < PROF_PHASES; i++) {
+		if (!t->issued[t->frame][i]) {
+			continue;
+		}
+
+		GLuint query = t->queries[t->frame][i];
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (available) {
+			GLuint64 ns;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+			prof_record(i, ns);
+		}
+
+		t->issued[t->frame][i] = false;
+	}
+}
+
+// Time elapsed queries cannot nest, a phase has to end before the next one
+// begins.
+void gputimer_begin(struct GpuTimer *t, enum ProfPhase phase) {
+	glBeginQuery(GL_TIME_ELAPSED, t->queries[t->frame][phase]);
+	t->issued[t->frame][phase] = true;
+}
+
+void gputimer_end(struct GpuTimer *t) {
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+void gputimer_free(struct GpuTimer *t) {
+	glDeleteQueries(GPUTIMER_FRAMES * PROF_PHASES, &t->queries[0][0]);
+}
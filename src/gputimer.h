@@ -0,0 +1,39 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <stdbool.h>
+#include <glad/gl.h>
+#include "profiler.h"
+#include "ringbuf.h"
+
+// Up to RINGBUF_REGIONS frames can be in flight, so a frame's queries are
+// only certain to be done once that many more frames have been queued.
+#define GPUTIMER_FRAMES (RINGBUF_REGIONS + 1)
+
+// GL_TIME_ELAPSED queries, one set per frame in flight and one more. The set
+// of a frame is only read back GPUTIMER_FRAMES frames later, when the GPU is
+// done with it, so reading the results never stalls and slow frames are not
+// dropped for being late.
+struct GpuTimer {
+	GLuint queries[GPUTIMER_FRAMES][PROF_PHASES];
+	bool issued[GPUTIMER_FRAMES][PROF_PHASES];
+	int frame;
+};
+
+void gputimer_init(struct GpuTimer *t);
+void gputimer_collect(struct GpuTimer *t);
+void gputimer_begin(struct GpuTimer *t, enum ProfPhase phase);
+void gputimer_end(struct GpuTimer *t);
+void gputimer_free(struct GpuTimer *t);
+
+#ifdef BOIDS_PROFILE
+#define GPU_PROF_COLLECT(t) gputimer_collect(t)
+#define GPU_PROF_BEGIN(t, phase) gputimer_begin(t, phase)
+#define GPU_PROF_END(t) gputimer_end(t)
+#else
+#define GPU_PROF_COLLECT(t)
+#define GPU_PROF_BEGIN(t, phase)
+#define GPU_PROF_END(t)
+#endif
+
+#endif
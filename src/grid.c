@@ -0,0 +1,232 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "grid.h"
+
+static void grid_alloc_cells(struct Grid *g, float w, float h, float cell_size) {
+	g->w = w;
+	g->h = h;
+	g->cell_size = fmaxf(cell_size, GRID_MIN_CELL_SIZE);
+	g->cols = fmaxf(1, ceilf(w / g->cell_size));
+	g->rows = fmaxf(1, ceilf(h / g->cell_size));
+
+	g->cell_start = calloc(g->cols * g->rows + 1, sizeof(int));
+	if (g->cell_start == NULL) {
+		fprintf(stderr, "Error while allocating grid cells");
+		abort();
+	}
+}
+
+void grid_init(struct Grid *g, float w, float h, float cell_size, int items_cap) {
+	grid_alloc_cells(g, w, h, cell_size);
+
+	g->items_len = 0;
+	g->items_cap = items_cap;
+	g->cell_of = calloc(items_cap, sizeof(int));
+	g->ids = calloc(items_cap, sizeof(int));
+	g->xs = calloc(items_cap, sizeof(float));
+	g->ys = calloc(items_cap, sizeof(float));
+	if (g->cell_of == NULL || g->ids == NULL || g->xs == NULL || g->ys == NULL) {
+		fprintf(stderr, "Error while allocating grid items");
+		abort();
+	}
+}
+
+// Only reallocates the cells when the bounds or the cell size actually
+// changed, so it is cheap to call before every build.
+void grid_resize(struct Grid *g, float w, float h, float cell_size) {
+	if (g->w == w && g->h == h && g->cell_size == fmaxf(cell_size, GRID_MIN_CELL_SIZE)) {
+		return;
+	}
+
+	free(g->cell_start);
+	grid_alloc_cells(g, w, h, cell_size);
+}
+
+static int grid_cell_x(struct Grid *g, float x) {
+	int cx = x / g->cell_size;
+	return cx < 0 ? 0 : (cx >= g->cols ? g->cols - 1 : cx);
+}
+
+static int grid_cell_y(struct Grid *g, float y) {
+	int cy = y / g->cell_size;
+	return cy < 0 ? 0 : (cy >= g->rows ? g->rows - 1 : cy);
+}
+
+// Counting sort of the items by cell: one pass to count the items of every
+// cell, a prefix sum to turn the counts into offsets and a second pass to
+// scatter the items into place.
+void grid_build(struct Grid *g, const float *x, const float *y, int len) {
+	if (len > g->items_cap) {
+		fprintf(stderr, "Grid item array is full");
+		abort();
+	}
+
+	int cells_len = g->cols * g->rows;
+	memset(g->cell_start, 0, (cells_len + 1) * sizeof(int));
+	g->items_len = len;
+
+	// Items are binned by the clamped coordinates that are stored for them.
+	// When the bounds are not a multiple of the cell size, an item past the
+	// edge would otherwise land in the last column or row while its stored
+	// coordinate lies in the one before, out of reach of queries around it.
+	for (int i = 0; i < len; i++) {
+		int cell = grid_cell_y(g, spatial_clamp(y[i], g->h)) * g->cols + grid_cell_x(g, spatial_clamp(x[i], g->w));
+
+		g->cell_of[i] = cell;
+		g->cell_start[cell + 1]++;
+	}
+
+	for (int i = 0; i < cells_len; i++) {
+		g->cell_start[i + 1] += g->cell_start[i];
+	}
+
+	for (int i = 0; i < len; i++) {
+		// cell_start[cell] is used as the insertion cursor and ends up
+		// pointing at the start of the next cell, which is shifted back below.
+		int j = g->cell_start[g->cell_of[i]]++;
+
+		g->ids[j] = i;
+		g->xs[j] = spatial_clamp(x[i], g->w);
+		g->ys[j] = spatial_clamp(y[i], g->h);
+	}
+
+	for (int i = cells_len; i > 0; i--) {
+		g->cell_start[i] = g->cell_start[i - 1];
+	}
+
+	g->cell_start[0] = 0;
+}
+
+// Reports the cells overlapping the bounding box of the circle, one span
+// per row. With cell_size equal to r this is the 3x3 neighborhood of the
+// cell holding (x, y). Callers are expected to do their own distance test.
+// Returns the number of cells visited.
+int grid_query_radius(struct Grid *g, float x, float y, float r, spatial_query_cb cb, void *data) {
+	int cx0 = grid_cell_x(g, x - r);
+	int cx1 = grid_cell_x(g, x + r);
+	int cy0 = grid_cell_y(g, y - r);
+	int cy1 = grid_cell_y(g, y + r);
+
+	for (int cy = cy0; cy <= cy1; cy++) {
+		int begin = g->cell_start[cy * g->cols + cx0];
+		int end = g->cell_start[cy * g->cols + cx1 + 1];
+
+		if (end > begin) {
+			cb(&g->ids[begin], &g->xs[begin], &g->ys[begin], end - begin, data);
+		}
+	}
+
+	return (cx1 - cx0 + 1) * (cy1 - cy0 + 1);
+}
+
+static void grid_nearest_cell(struct Grid *g, int cx, int cy, float x, float y, struct SpatialNearest *n) {
+	if (cx < 0 || cy < 0 || cx >= g->cols || cy >= g->rows) {
+		return;
+	}
+
+	int cell = cy * g->cols + cx;
+
+	for (int i = g->cell_start[cell]; i < g->cell_start[cell + 1]; i++) {
+		float dx = g->xs[i] - x;
+		float dy = g->ys[i] - y;
+		spatial_nearest_push(n, g->ids[i], dx * dx + dy * dy);
+	}
+}
+
+// Visits rings of cells around the cell holding (x, y) until the k-th
+// closest item found so far is nearer than anything the next ring can hold.
+int grid_query_nearest(struct Grid *g, float x, float y, int k, int *out, float *out_d2) {
+	struct SpatialNearest n = {out, out_d2, k, 0};
+	int cx = grid_cell_x(g, x);
+	int cy = grid_cell_y(g, y);
+	int rings = g->cols > g->rows ? g->cols : g->rows;
+
+	for (int d = 0; d < rings; d++) {
+		// The point can sit anywhere in its cell, so ring d is only known to
+		// be at least d - 1 cells away.
+		float reach = (d - 1) * g->cell_size;
+
+		if (d > 1 && reach * reach >= spatial_nearest_bound(&n)) {
+			break;
+		}
+
+		if (d == 0) {
+			grid_nearest_cell(g, cx, cy, x, y, &n);
+			continue;
+		}
+
+		for (int i = -d; i <= d; i++) {
+			grid_nearest_cell(g, cx + i, cy - d, x, y, &n);
+			grid_nearest_cell(g, cx + i, cy + d, x, y, &n);
+		}
+
+		for (int i = -d + 1; i < d; i++) {
+			grid_nearest_cell(g, cx - d, cy + i, x, y, &n);
+			grid_nearest_cell(g, cx + d, cy + i, x, y, &n);
+		}
+	}
+
+	return n.len;
+}
+
+size_t grid_size(struct Grid *g) {
+	return (g->cols * g->rows + 1) * sizeof(int) + g->items_cap * (2 * sizeof(int) + 2 * sizeof(float));
+}
+
+void grid_free(struct Grid *g) {
+	free(g->cell_start);
+	free(g->cell_of);
+	free(g->ids);
+	free(g->xs);
+	free(g->ys);
+
+	g->cell_start = NULL;
+	g->cell_of = NULL;
+	g->ids = NULL;
+	g->xs = NULL;
+	g->ys = NULL;
+	g->items_len = 0;
+	g->items_cap = 0;
+}
+
+static struct Grid grid;
+
+static void grid_index_init(int items_cap) {
+	grid_init(&grid, 0, 0, GRID_MIN_CELL_SIZE, items_cap);
+}
+
+static void grid_index_free() {
+	grid_free(&grid);
+}
+
+static void grid_index_build(const float *x, const float *y, int len, float w, float h, float range) {
+	grid_resize(&grid, w, h, range);
+	grid_build(&grid, x, y, len);
+}
+
+static int grid_index_query_radius(float x, float y, float r, spatial_query_cb cb, void *data) {
+	return grid_query_radius(&grid, x, y, r, cb, data);
+}
+
+static int grid_index_query_nearest(float x, float y, int k, int *out, float *out_d2) {
+	return grid_query_nearest(&grid, x, y, k, out, out_d2);
+}
+
+static void grid_index_stats(struct SpatialStats *stats) {
+	stats->bytes = grid_size(&grid);
+	stats->nodes = grid.cols * grid.rows;
+	stats->items = grid.items_len;
+}
+
+const struct SpatialIndex grid_index = {
+	.name = "grid",
+	.init = grid_index_init,
+	.free = grid_index_free,
+	.build = grid_index_build,
+	.query_radius = grid_index_query_radius,
+	.query_nearest = grid_index_query_nearest,
+	.stats = grid_index_stats,
+};
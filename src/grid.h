@@ -0,0 +1,37 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stddef.h>
+#include "spatial.h"
+
+#define GRID_MIN_CELL_SIZE 1.0f
+
+struct Grid {
+	float w;
+	float h;
+	float cell_size;
+
+	int cols;
+	int rows;
+
+	// Items of cell i are stored from cell_start[i] up to cell_start[i + 1],
+	// cells are stored row by row.
+	int *cell_start;
+	int *cell_of;
+
+	int *ids;
+	float *xs;
+	float *ys;
+	int items_len;
+	int items_cap;
+};
+
+void grid_init(struct Grid *g, float w, float h, float cell_size, int items_cap);
+void grid_resize(struct Grid *g, float w, float h, float cell_size);
+void grid_build(struct Grid *g, const float *x, const float *y, int len);
+int grid_query_radius(struct Grid *g, float x, float y, float r, spatial_query_cb cb, void *data);
+int grid_query_nearest(struct Grid *g, float x, float y, int k, int *out, float *out_d2);
+size_t grid_size(struct Grid *g);
+void grid_free(struct Grid *g);
+
+#endif
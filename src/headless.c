@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "kernels.h"
+#include "workers.h"
+#include "trace.h"
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+	int boid_count = 5000;
+	int steps = 1000;
+	int threads = workers_default_count();
+	const struct SpatialIndex *spatial_index = &quadtree_index;
+	const char *trace_path = NULL;
+	uint64_t seed = 1;
+	struct SimParams params = sim_default_params;
+	bool pairwise = false;
+	bool check = false;
+	float spread = 100;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			boid_count = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			steps = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace_path = argv[++i];
+		} else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+			spatial_index = spatial_find(argv[++i]);
+			if (spatial_index == NULL) {
+				fprintf(stderr, "unknown spatial index: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--pairs") == 0) {
+			pairwise = true;
+		} else if (strcmp(argv[i], "--spread") == 0 && i + 1 < argc) {
+			spread = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--check") == 0) {
+			check = true;
+		} else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+			params.width = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+			params.height = atof(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [-n BOIDS] [-s STEPS] [--threads N] [--index quadtree|quadtree-inc|grid] [--pairs] [--width W] [--height H] [--seed N] [--spread S] [--trace FILE] [--check]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (boid_count < 1 || steps < 1) {
+		fprintf(stderr, "boid and step counts must be positive\n");
+		return -1;
+	}
+
+	if (trace_path != NULL && !trace_open(trace_path)) {
+		fprintf(stderr, "failed to open trace file: %s\n", trace_path);
+		return -1;
+	}
+
+	workers_init(threads);
+
+	struct Sim sim = {.params = params, .pairwise = pairwise};
+	sim_init(&sim, boid_count, spatial_index);
+	sim_spawn(&sim, params.width / 2, params.height / 2, spread, seed);
+
+	double start = now();
+	for (int i = 0; i < steps; i++) {
+		sim_step(&sim);
+	}
+	double elapsed = now() - start;
+
+	printf("boids: %d, steps: %d, threads: %d, index: %s, seed: %llu, isa: %s\n", boid_count, steps, workers_count(), pairwise ? "pairs" : spatial_index->name, (unsigned long long)seed, kernels.isa);
+	printf("steps/s: %.2f\n", steps / elapsed);
+	printf("ns/boid/step: %.2f\n", elapsed * 1e9 / ((double)steps * boid_count));
+
+	int differs = 0;
+	if (check) {
+		differs = sim_check_neighbors(&sim);
+		printf("check: %d of %d neighborhoods differ from a brute-force search\n", differs, boid_count);
+	}
+
+	sim_free(&sim);
+	workers_free();
+	trace_close();
+
+	return differs == 0 ? 0 : -1;
+}
@@ -0,0 +1,194 @@
+#include <stdbool.h>
+#include <math.h>
+#include "kernels.h"
+
+void kernels_neighbors_scalar(const int *ids, const float *xs, const float *ys, int len, void *data) {
+	struct Neighborhood *n = data;
+
+	float visible2 = n->visible2;
+	float protected2 = n->protected2;
+
+	float close_dx = 0, close_dy = 0;
+	float avg_x = 0, avg_y = 0, avg_vx = 0, avg_vy = 0;
+	int visible_count = 0;
+
+	for (int j = 0; j < len; j++) {
+		float dx = n->x - xs[j];
+		float dy = n->y - ys[j];
+		float distance = dx * dx + dy * dy;
+
+		bool close = distance < visible2 && distance < protected2;
+		bool visible = distance < visible2 && !(distance < protected2);
+
+		close_dx += close ? dx : 0;
+		close_dy += close ? dy : 0;
+
+		avg_x += visible ? xs[j] : 0;
+		avg_y += visible ? ys[j] : 0;
+		avg_vx += visible ? n->vx[ids[j]] : 0;
+		avg_vy += visible ? n->vy[ids[j]] : 0;
+
+		visible_count += visible;
+	}
+
+	n->close_dx += close_dx;
+	n->close_dy += close_dy;
+	n->avg_x += avg_x;
+	n->avg_y += avg_y;
+	n->avg_vx += avg_vx;
+	n->avg_vy += avg_vy;
+	n->visible_count += visible_count;
+}
+
+void kernels_pairs_scalar(const struct PairPoints *pts, int i, int begin, int end, struct PairSums *own,
+	struct PairSums *other) {
+	float x = pts->x[i];
+	float y = pts->y[i];
+	float vx = pts->vx[i];
+	float vy = pts->vy[i];
+	float visible2 = pts->visible2;
+	float protected2 = pts->protected2;
+
+	float close_dx = 0, close_dy = 0;
+	float avg_x = 0, avg_y = 0, avg_vx = 0, avg_vy = 0;
+	int visible_count = 0;
+
+	for (int j = begin; j < end; j++) {
+		float dx = x - pts->x[j];
+		float dy = y - pts->y[j];
+		float distance = dx * dx + dy * dy;
+
+		if (!(distance < visible2)) {
+			continue;
+		}
+
+		if (distance < protected2) {
+			close_dx += dx;
+			close_dy += dy;
+			other->close_dx[j] -= dx;
+			other->close_dy[j] -= dy;
+		} else {
+			avg_x += pts->x[j];
+			avg_y += pts->y[j];
+			avg_vx += pts->vx[j];
+			avg_vy += pts->vy[j];
+			visible_count++;
+
+			other->avg_x[j] += x;
+			other->avg_y[j] += y;
+			other->avg_vx[j] += vx;
+			other->avg_vy[j] += vy;
+			other->visible_count[j]++;
+		}
+	}
+
+	own->close_dx[i] += close_dx;
+	own->close_dy[i] += close_dy;
+	own->avg_x[i] += avg_x;
+	own->avg_y[i] += avg_y;
+	own->avg_vx[i] += avg_vx;
+	own->avg_vy[i] += avg_vy;
+	own->visible_count[i] += visible_count;
+}
+
+void kernels_integrate_scalar(const struct SimParams *p, const struct BoidState *front, struct BoidState *back,
+	const uint8_t *group, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		float vx = back->vx[i];
+		float vy = back->vy[i];
+		float bias = front->bias[i];
+		enum Group g = group[i];
+
+		if (g == RIGHT) {
+			if (vx > 0) {
+				bias = fminf(p->max_bias, bias + p->bias_increment);
+			} else {
+				bias = fmaxf(p->bias_increment, bias - p->bias_increment);
+			}
+		} else if (g == LEFT) {
+			if (vx < 0) {
+				bias = fminf(p->max_bias, bias + p->bias_increment);
+			} else {
+				bias = fmaxf(p->bias_increment, bias - p->bias_increment);
+			}
+		} else if (g == BOTTOM) {
+			if (vy > 0) {
+				bias = fminf(p->max_bias, bias + p->bias_increment);
+			} else {
+				bias = fmaxf(p->bias_increment, bias - p->bias_increment);
+			}
+		} else if (g == TOP) {
+			if (vy < 0) {
+				bias = fminf(p->max_bias, bias + p->bias_increment);
+			} else {
+				bias = fmaxf(p->bias_increment, bias - p->bias_increment);
+			}
+		}
+
+		if (g == RIGHT) {
+			vx = (1 - bias)*vx + (bias * 1);
+		} else if (g == LEFT) {
+			vx = (1 - bias)*vx + (bias * -1);
+		} else if (g == BOTTOM) {
+			vy = (1 - bias)*vy + (bias * 1);
+		} else if (g == TOP) {
+			vy = (1 - bias)*vy + (bias * -1);
+		}
+
+		float speed = sqrtf(vx * vx + vy * vy);
+
+		if (speed < p->min_speed) {
+			vx = (vx / speed) * p->min_speed;
+			vy = (vy / speed) * p->min_speed;
+		} else if (speed > p->max_speed) {
+			vx = (vx / speed) * p->max_speed;
+			vy = (vy / speed) * p->max_speed;
+		}
+
+		back->x[i] = front->x[i] + vx;
+		back->y[i] = front->y[i] + vy;
+		back->vx[i] = vx;
+		back->vy[i] = vy;
+		back->bias[i] = bias;
+	}
+}
+
+void kernels_fill_instances_scalar(float *out, const struct BoidState *prev, const struct BoidState *cur, float alpha,
+	int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		out[4 * i + 0] = prev->x[i] + (cur->x[i] - prev->x[i]) * alpha;
+		out[4 * i + 1] = prev->y[i] + (cur->y[i] - prev->y[i]) * alpha;
+		out[4 * i + 2] = prev->vx[i] + (cur->vx[i] - prev->vx[i]) * alpha;
+		out[4 * i + 3] = prev->vy[i] + (cur->vy[i] - prev->vy[i]) * alpha;
+	}
+}
+
+static void kernels_fill_instances(float *out, const struct BoidState *prev, const struct BoidState *cur, float alpha, int len) {
+	kernels_fill_instances_scalar(out, prev, cur, alpha, 0, len);
+}
+
+const struct Kernels kernels_scalar = {
+	.isa = "scalar",
+	.neighbors = kernels_neighbors_scalar,
+	.pairs = kernels_pairs_scalar,
+	.integrate = kernels_integrate_scalar,
+	.fill_instances = kernels_fill_instances,
+};
+
+struct Kernels kernels;
+
+void kernels_init() {
+	kernels = kernels_scalar;
+
+#ifdef BOIDS_X86_KERNELS
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f")) {
+		kernels = kernels_avx512;
+	} else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		kernels = kernels_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		kernels = kernels_sse2;
+	}
+#endif
+}
@@ -0,0 +1,101 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "sim.h"
+#include "spatial.h"
+
+// Sums of the neighbors of the boid at (x, y), filled in span by span by
+// the neighbors kernel. Velocities are gathered by id from vx and vy.
+struct Neighborhood {
+	const float *vx;
+	const float *vy;
+
+	float x;
+	float y;
+	float visible2;
+	float protected2;
+
+	float close_dx;
+	float close_dy;
+	float avg_x;
+	float avg_y;
+	float avg_vx;
+	float avg_vy;
+
+	int visible_count;
+};
+
+// Positions and velocities of the pair pass, indexed by pair grid slot.
+struct PairPoints {
+	const float *x;
+	const float *y;
+	const float *vx;
+	const float *vy;
+
+	float visible2;
+	float protected2;
+};
+
+// Neighbor sums of the pair pass, indexed by pair grid slot.
+struct PairSums {
+	float *close_dx;
+	float *close_dy;
+	float *avg_x;
+	float *avg_y;
+	float *avg_vx;
+	float *avg_vy;
+	int *visible_count;
+};
+
+// The hot loops of a step and of a frame. Every variant is built in its own
+// translation unit with the flags of its instruction set, kernels_init()
+// picks the widest one the CPU supports. Distances are computed with a
+// separate multiply and add in every variant, so a candidate is always
+// classified the same way, but the neighbor sums are not rounded alike: a
+// seed only reproduces a run on machines that pick the same variant.
+struct Kernels {
+	const char *isa;
+
+	// Accumulates a span of candidates into the struct Neighborhood data.
+	// The vector variants keep one partial sum per lane and add the lanes up
+	// at the end of the span, so their sums are rounded in a different order
+	// than the scalar ones. Spans shorter than a vector are left to the
+	// scalar loop.
+	spatial_query_cb neighbors;
+
+	// Interacts boid i with every boid of [begin, end) once, as both the
+	// boid and the neighbor: the sums of i are added to own and those of
+	// the others to other. Only the neighbors' sums are written in the
+	// loop, so own and other may be the same.
+	void (*pairs)(const struct PairPoints *pts, int i, int begin, int end, struct PairSums *own, struct PairSums *other);
+
+	// Applies the group bias and the speed limits to the velocities already
+	// in back, then moves the boids of [begin, end) from front into back.
+	// Every variant gives the same result as the scalar one, bit for bit.
+	void (*integrate)(const struct SimParams *p, const struct BoidState *front, struct BoidState *back,
+		const uint8_t *group, int begin, int end);
+
+	// Writes one vec4 of position and velocity per boid, interpolated from
+	// prev to cur by alpha.
+	void (*fill_instances)(float *out, const struct BoidState *prev, const struct BoidState *cur, float alpha, int len);
+};
+
+extern struct Kernels kernels;
+
+extern const struct Kernels kernels_scalar;
+extern const struct Kernels kernels_sse2;
+extern const struct Kernels kernels_avx2;
+extern const struct Kernels kernels_avx512;
+
+void kernels_init();
+
+// Used by the vector variants for what is left past their last full vector.
+void kernels_neighbors_scalar(const int *ids, const float *xs, const float *ys, int len, void *data);
+void kernels_pairs_scalar(const struct PairPoints *pts, int i, int begin, int end, struct PairSums *own,
+	struct PairSums *other);
+void kernels_integrate_scalar(const struct SimParams *p, const struct BoidState *front, struct BoidState *back,
+	const uint8_t *group, int begin, int end);
+void kernels_fill_instances_scalar(float *out, const struct BoidState *prev, const struct BoidState *cur, float alpha,
+	int begin, int end);
+
+#endif
@@ -0,0 +1,252 @@
+#include <immintrin.h>
+#include "kernels.h"
+
+static inline float sum_256(__m256 v) {
+	__m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	__m128 hi = _mm_movehl_ps(lo, lo);
+	lo = _mm_add_ps(lo, hi);
+	lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+
+	return _mm_cvtss_f32(lo);
+}
+
+static void neighbors_avx2(const int *ids, const float *xs, const float *ys, int len, void *data) {
+	if (len < 8) {
+		kernels_neighbors_scalar(ids, xs, ys, len, data);
+		return;
+	}
+
+	struct Neighborhood *n = data;
+
+	__m256 x = _mm256_set1_ps(n->x);
+	__m256 y = _mm256_set1_ps(n->y);
+	__m256 visible2 = _mm256_set1_ps(n->visible2);
+	__m256 protected2 = _mm256_set1_ps(n->protected2);
+
+	__m256 close_dx = _mm256_setzero_ps(), close_dy = _mm256_setzero_ps();
+	__m256 avg_x = _mm256_setzero_ps(), avg_y = _mm256_setzero_ps();
+	__m256 avg_vx = _mm256_setzero_ps(), avg_vy = _mm256_setzero_ps();
+	int visible_count = 0;
+	int j = 0;
+
+	for (; j + 8 <= len; j += 8) {
+		__m256 xj = _mm256_loadu_ps(&xs[j]);
+		__m256 yj = _mm256_loadu_ps(&ys[j]);
+		__m256 dx = _mm256_sub_ps(x, xj);
+		__m256 dy = _mm256_sub_ps(y, yj);
+		__m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+		__m256 in_visible = _mm256_cmp_ps(distance, visible2, _CMP_LT_OQ);
+		__m256 in_protected = _mm256_cmp_ps(distance, protected2, _CMP_LT_OQ);
+		__m256 close = _mm256_and_ps(in_visible, in_protected);
+		__m256 visible = _mm256_andnot_ps(in_protected, in_visible);
+
+		int mask = _mm256_movemask_ps(visible);
+
+		close_dx = _mm256_add_ps(close_dx, _mm256_and_ps(close, dx));
+		close_dy = _mm256_add_ps(close_dy, _mm256_and_ps(close, dy));
+
+		if (mask == 0) {
+			continue;
+		}
+
+		__m256i id = _mm256_loadu_si256((const __m256i *)&ids[j]);
+		__m256 vx = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), n->vx, id, visible, 4);
+		__m256 vy = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), n->vy, id, visible, 4);
+
+		avg_x = _mm256_add_ps(avg_x, _mm256_and_ps(visible, xj));
+		avg_y = _mm256_add_ps(avg_y, _mm256_and_ps(visible, yj));
+		avg_vx = _mm256_add_ps(avg_vx, vx);
+		avg_vy = _mm256_add_ps(avg_vy, vy);
+		visible_count += __builtin_popcount(mask);
+	}
+
+	n->close_dx += sum_256(close_dx);
+	n->close_dy += sum_256(close_dy);
+	n->avg_x += sum_256(avg_x);
+	n->avg_y += sum_256(avg_y);
+	n->avg_vx += sum_256(avg_vx);
+	n->avg_vy += sum_256(avg_vy);
+	n->visible_count += visible_count;
+
+	kernels_neighbors_scalar(ids + j, xs + j, ys + j, len - j, data);
+}
+
+static inline void add_256(float *p, __m256 mask, __m256 v) {
+	_mm256_storeu_ps(p, _mm256_add_ps(_mm256_loadu_ps(p), _mm256_and_ps(mask, v)));
+}
+
+// The neighbors' sums are read, updated and written back a vector at a time,
+// their slots are consecutive so no scatter is needed.
+static void pairs_avx2(const struct PairPoints *pts, int i, int begin, int end, struct PairSums *own, struct PairSums *other) {
+	if (end - begin < 8) {
+		kernels_pairs_scalar(pts, i, begin, end, own, other);
+		return;
+	}
+
+	__m256 x = _mm256_set1_ps(pts->x[i]);
+	__m256 y = _mm256_set1_ps(pts->y[i]);
+	__m256 vx = _mm256_set1_ps(pts->vx[i]);
+	__m256 vy = _mm256_set1_ps(pts->vy[i]);
+	__m256 visible2 = _mm256_set1_ps(pts->visible2);
+	__m256 protected2 = _mm256_set1_ps(pts->protected2);
+
+	__m256 close_dx = _mm256_setzero_ps(), close_dy = _mm256_setzero_ps();
+	__m256 avg_x = _mm256_setzero_ps(), avg_y = _mm256_setzero_ps();
+	__m256 avg_vx = _mm256_setzero_ps(), avg_vy = _mm256_setzero_ps();
+	int visible_count = 0;
+	int j = begin;
+
+	for (; j + 8 <= end; j += 8) {
+		__m256 xj = _mm256_loadu_ps(&pts->x[j]);
+		__m256 yj = _mm256_loadu_ps(&pts->y[j]);
+		__m256 dx = _mm256_sub_ps(x, xj);
+		__m256 dy = _mm256_sub_ps(y, yj);
+		__m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+		__m256 in_visible = _mm256_cmp_ps(distance, visible2, _CMP_LT_OQ);
+		if (_mm256_movemask_ps(in_visible) == 0) {
+			continue;
+		}
+
+		__m256 in_protected = _mm256_cmp_ps(distance, protected2, _CMP_LT_OQ);
+		__m256 close = _mm256_and_ps(in_visible, in_protected);
+		__m256 visible = _mm256_andnot_ps(in_protected, in_visible);
+
+		close_dx = _mm256_add_ps(close_dx, _mm256_and_ps(close, dx));
+		close_dy = _mm256_add_ps(close_dy, _mm256_and_ps(close, dy));
+		add_256(&other->close_dx[j], close, _mm256_sub_ps(_mm256_setzero_ps(), dx));
+		add_256(&other->close_dy[j], close, _mm256_sub_ps(_mm256_setzero_ps(), dy));
+
+		int mask = _mm256_movemask_ps(visible);
+		if (mask == 0) {
+			continue;
+		}
+
+		avg_x = _mm256_add_ps(avg_x, _mm256_and_ps(visible, xj));
+		avg_y = _mm256_add_ps(avg_y, _mm256_and_ps(visible, yj));
+		avg_vx = _mm256_add_ps(avg_vx, _mm256_and_ps(visible, _mm256_loadu_ps(&pts->vx[j])));
+		avg_vy = _mm256_add_ps(avg_vy, _mm256_and_ps(visible, _mm256_loadu_ps(&pts->vy[j])));
+		visible_count += __builtin_popcount(mask);
+
+		add_256(&other->avg_x[j], visible, x);
+		add_256(&other->avg_y[j], visible, y);
+		add_256(&other->avg_vx[j], visible, vx);
+		add_256(&other->avg_vy[j], visible, vy);
+
+		// Visible lanes are all ones, -1.
+		__m256i count = _mm256_loadu_si256((const __m256i *)&other->visible_count[j]);
+		count = _mm256_sub_epi32(count, _mm256_castps_si256(visible));
+		_mm256_storeu_si256((__m256i *)&other->visible_count[j], count);
+	}
+
+	own->close_dx[i] += sum_256(close_dx);
+	own->close_dy[i] += sum_256(close_dy);
+	own->avg_x[i] += sum_256(avg_x);
+	own->avg_y[i] += sum_256(avg_y);
+	own->avg_vx[i] += sum_256(avg_vx);
+	own->avg_vy[i] += sum_256(avg_vy);
+	own->visible_count[i] += visible_count;
+
+	kernels_pairs_scalar(pts, i, j, end, own, other);
+}
+
+// The group picks the axis the bias pulls along, the y axis for BOTTOM and
+// TOP, and its sign, negative for LEFT and TOP. Both velocities are worked
+// out for every lane and blended, with the same operations in the same
+// order as the scalar loop.
+static void integrate_avx2(const struct SimParams *p, const struct BoidState *front, struct BoidState *back,
+	const uint8_t *group, int begin, int end) {
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1);
+	__m256 max_bias = _mm256_set1_ps(p->max_bias);
+	__m256 increment = _mm256_set1_ps(p->bias_increment);
+	__m256 min_speed = _mm256_set1_ps(p->min_speed);
+	__m256 max_speed = _mm256_set1_ps(p->max_speed);
+	__m256i axis_bit = _mm256_set1_epi32(2);
+	__m256i sign_bit = _mm256_set1_epi32(1);
+	int i = begin;
+
+	for (; i + 8 <= end; i += 8) {
+		__m256 vx = _mm256_loadu_ps(&back->vx[i]);
+		__m256 vy = _mm256_loadu_ps(&back->vy[i]);
+		__m256 bias = _mm256_loadu_ps(&front->bias[i]);
+		__m256i g = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&group[i]));
+
+		__m256 on_y = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(g, axis_bit), axis_bit));
+		__m256 negative = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(g, sign_bit), sign_bit));
+		__m256 sign = _mm256_blendv_ps(one, _mm256_set1_ps(-1), negative);
+		__m256 v = _mm256_blendv_ps(vx, vy, on_y);
+
+		__m256 heading = _mm256_cmp_ps(_mm256_mul_ps(sign, v), zero, _CMP_GT_OQ);
+		__m256 up = _mm256_min_ps(max_bias, _mm256_add_ps(bias, increment));
+		__m256 down = _mm256_max_ps(increment, _mm256_sub_ps(bias, increment));
+		bias = _mm256_blendv_ps(down, up, heading);
+
+		v = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(one, bias), v), _mm256_mul_ps(bias, sign));
+		vx = _mm256_blendv_ps(v, vx, on_y);
+		vy = _mm256_blendv_ps(vy, v, on_y);
+
+		__m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+		__m256 slow = _mm256_cmp_ps(speed, min_speed, _CMP_LT_OQ);
+		__m256 fast = _mm256_cmp_ps(speed, max_speed, _CMP_GT_OQ);
+		__m256 clamp = _mm256_or_ps(slow, fast);
+		__m256 limit = _mm256_blendv_ps(max_speed, min_speed, slow);
+
+		vx = _mm256_blendv_ps(vx, _mm256_mul_ps(_mm256_div_ps(vx, speed), limit), clamp);
+		vy = _mm256_blendv_ps(vy, _mm256_mul_ps(_mm256_div_ps(vy, speed), limit), clamp);
+
+		_mm256_storeu_ps(&back->x[i], _mm256_add_ps(_mm256_loadu_ps(&front->x[i]), vx));
+		_mm256_storeu_ps(&back->y[i], _mm256_add_ps(_mm256_loadu_ps(&front->y[i]), vy));
+		_mm256_storeu_ps(&back->vx[i], vx);
+		_mm256_storeu_ps(&back->vy[i], vy);
+		_mm256_storeu_ps(&back->bias[i], bias);
+	}
+
+	kernels_integrate_scalar(p, front, back, group, i, end);
+}
+
+static inline __m256 lerp_256(const float *prev, const float *cur, __m256 alpha) {
+	__m256 p = _mm256_loadu_ps(prev);
+
+	return _mm256_add_ps(p, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(cur), p), alpha));
+}
+
+static void fill_instances_avx2(float *out, const struct BoidState *prev, const struct BoidState *cur, float alpha, int len) {
+	__m256 a = _mm256_set1_ps(alpha);
+	int i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		__m256 x = lerp_256(&prev->x[i], &cur->x[i], a);
+		__m256 y = lerp_256(&prev->y[i], &cur->y[i], a);
+		__m256 vx = lerp_256(&prev->vx[i], &cur->vx[i], a);
+		__m256 vy = lerp_256(&prev->vy[i], &cur->vy[i], a);
+
+		// Transposed within each 128-bit half, boids 0-3 in the low halves
+		// and 4-7 in the high ones.
+		__m256 xy_lo = _mm256_unpacklo_ps(x, y);
+		__m256 xy_hi = _mm256_unpackhi_ps(x, y);
+		__m256 v_lo = _mm256_unpacklo_ps(vx, vy);
+		__m256 v_hi = _mm256_unpackhi_ps(vx, vy);
+
+		__m256 b0 = _mm256_shuffle_ps(xy_lo, v_lo, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 b1 = _mm256_shuffle_ps(xy_lo, v_lo, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 b2 = _mm256_shuffle_ps(xy_hi, v_hi, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 b3 = _mm256_shuffle_ps(xy_hi, v_hi, _MM_SHUFFLE(3, 2, 3, 2));
+
+		_mm256_storeu_ps(&out[4 * i + 0], _mm256_permute2f128_ps(b0, b1, 0x20));
+		_mm256_storeu_ps(&out[4 * i + 8], _mm256_permute2f128_ps(b2, b3, 0x20));
+		_mm256_storeu_ps(&out[4 * i + 16], _mm256_permute2f128_ps(b0, b1, 0x31));
+		_mm256_storeu_ps(&out[4 * i + 24], _mm256_permute2f128_ps(b2, b3, 0x31));
+	}
+
+	kernels_fill_instances_scalar(out, prev, cur, alpha, i, len);
+}
+
+const struct Kernels kernels_avx2 = {
+	.isa = "avx2",
+	.neighbors = neighbors_avx2,
+	.pairs = pairs_avx2,
+	.integrate = integrate_avx2,
+	.fill_instances = fill_instances_avx2,
+};
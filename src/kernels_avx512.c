@@ -0,0 +1,245 @@
+#include <immintrin.h>
+#include "kernels.h"
+
+// Candidates past the last full vector are masked off rather than left to
+// the scalar loop.
+static void neighbors_avx512(const int *ids, const float *xs, const float *ys, int len, void *data) {
+	if (len < 8) {
+		kernels_neighbors_scalar(ids, xs, ys, len, data);
+		return;
+	}
+
+	struct Neighborhood *n = data;
+
+	__m512 x = _mm512_set1_ps(n->x);
+	__m512 y = _mm512_set1_ps(n->y);
+	__m512 visible2 = _mm512_set1_ps(n->visible2);
+	__m512 protected2 = _mm512_set1_ps(n->protected2);
+
+	__m512 close_dx = _mm512_setzero_ps(), close_dy = _mm512_setzero_ps();
+	__m512 avg_x = _mm512_setzero_ps(), avg_y = _mm512_setzero_ps();
+	__m512 avg_vx = _mm512_setzero_ps(), avg_vy = _mm512_setzero_ps();
+	int visible_count = 0;
+
+	for (int j = 0; j < len; j += 16) {
+		__mmask16 lanes = len - j >= 16 ? 0xffff : (1u << (len - j)) - 1;
+
+		__m512 xj = _mm512_maskz_loadu_ps(lanes, &xs[j]);
+		__m512 yj = _mm512_maskz_loadu_ps(lanes, &ys[j]);
+		__m512 dx = _mm512_sub_ps(x, xj);
+		__m512 dy = _mm512_sub_ps(y, yj);
+		__m512 distance = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+
+		__mmask16 in_visible = _mm512_mask_cmp_ps_mask(lanes, distance, visible2, _CMP_LT_OQ);
+		__mmask16 in_protected = _mm512_cmp_ps_mask(distance, protected2, _CMP_LT_OQ);
+		__mmask16 close = in_visible & in_protected;
+		__mmask16 visible = in_visible & ~in_protected;
+
+		close_dx = _mm512_mask_add_ps(close_dx, close, close_dx, dx);
+		close_dy = _mm512_mask_add_ps(close_dy, close, close_dy, dy);
+
+		if (visible == 0) {
+			continue;
+		}
+
+		__m512i id = _mm512_maskz_loadu_epi32(visible, &ids[j]);
+		__m512 vx = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), visible, id, n->vx, 4);
+		__m512 vy = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), visible, id, n->vy, 4);
+
+		avg_x = _mm512_mask_add_ps(avg_x, visible, avg_x, xj);
+		avg_y = _mm512_mask_add_ps(avg_y, visible, avg_y, yj);
+		avg_vx = _mm512_mask_add_ps(avg_vx, visible, avg_vx, vx);
+		avg_vy = _mm512_mask_add_ps(avg_vy, visible, avg_vy, vy);
+		visible_count += __builtin_popcount(visible);
+	}
+
+	n->close_dx += _mm512_reduce_add_ps(close_dx);
+	n->close_dy += _mm512_reduce_add_ps(close_dy);
+	n->avg_x += _mm512_reduce_add_ps(avg_x);
+	n->avg_y += _mm512_reduce_add_ps(avg_y);
+	n->avg_vx += _mm512_reduce_add_ps(avg_vx);
+	n->avg_vy += _mm512_reduce_add_ps(avg_vy);
+	n->visible_count += visible_count;
+}
+
+static inline void add_512(float *p, __mmask16 mask, __m512 v) {
+	_mm512_mask_storeu_ps(p, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, p), v));
+}
+
+// See pairs_avx2(). The boids past the last full vector are masked off.
+static void pairs_avx512(const struct PairPoints *pts, int i, int begin, int end, struct PairSums *own, struct PairSums *other) {
+	if (end - begin < 8) {
+		kernels_pairs_scalar(pts, i, begin, end, own, other);
+		return;
+	}
+
+	__m512 x = _mm512_set1_ps(pts->x[i]);
+	__m512 y = _mm512_set1_ps(pts->y[i]);
+	__m512 vx = _mm512_set1_ps(pts->vx[i]);
+	__m512 vy = _mm512_set1_ps(pts->vy[i]);
+	__m512 visible2 = _mm512_set1_ps(pts->visible2);
+	__m512 protected2 = _mm512_set1_ps(pts->protected2);
+	__m512i one = _mm512_set1_epi32(1);
+
+	__m512 close_dx = _mm512_setzero_ps(), close_dy = _mm512_setzero_ps();
+	__m512 avg_x = _mm512_setzero_ps(), avg_y = _mm512_setzero_ps();
+	__m512 avg_vx = _mm512_setzero_ps(), avg_vy = _mm512_setzero_ps();
+	int visible_count = 0;
+
+	for (int j = begin; j < end; j += 16) {
+		__mmask16 lanes = end - j >= 16 ? 0xffff : (1u << (end - j)) - 1;
+
+		__m512 xj = _mm512_maskz_loadu_ps(lanes, &pts->x[j]);
+		__m512 yj = _mm512_maskz_loadu_ps(lanes, &pts->y[j]);
+		__m512 dx = _mm512_sub_ps(x, xj);
+		__m512 dy = _mm512_sub_ps(y, yj);
+		__m512 distance = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+
+		__mmask16 in_visible = _mm512_mask_cmp_ps_mask(lanes, distance, visible2, _CMP_LT_OQ);
+		if (in_visible == 0) {
+			continue;
+		}
+
+		__mmask16 in_protected = _mm512_cmp_ps_mask(distance, protected2, _CMP_LT_OQ);
+		__mmask16 close = in_visible & in_protected;
+		__mmask16 visible = in_visible & ~in_protected;
+
+		close_dx = _mm512_mask_add_ps(close_dx, close, close_dx, dx);
+		close_dy = _mm512_mask_add_ps(close_dy, close, close_dy, dy);
+		add_512(&other->close_dx[j], close, _mm512_sub_ps(_mm512_setzero_ps(), dx));
+		add_512(&other->close_dy[j], close, _mm512_sub_ps(_mm512_setzero_ps(), dy));
+
+		if (visible == 0) {
+			continue;
+		}
+
+		avg_x = _mm512_mask_add_ps(avg_x, visible, avg_x, xj);
+		avg_y = _mm512_mask_add_ps(avg_y, visible, avg_y, yj);
+		avg_vx = _mm512_mask_add_ps(avg_vx, visible, avg_vx, _mm512_maskz_loadu_ps(visible, &pts->vx[j]));
+		avg_vy = _mm512_mask_add_ps(avg_vy, visible, avg_vy, _mm512_maskz_loadu_ps(visible, &pts->vy[j]));
+		visible_count += __builtin_popcount(visible);
+
+		add_512(&other->avg_x[j], visible, x);
+		add_512(&other->avg_y[j], visible, y);
+		add_512(&other->avg_vx[j], visible, vx);
+		add_512(&other->avg_vy[j], visible, vy);
+
+		__m512i count = _mm512_maskz_loadu_epi32(visible, &other->visible_count[j]);
+		_mm512_mask_storeu_epi32(&other->visible_count[j], visible, _mm512_add_epi32(count, one));
+	}
+
+	own->close_dx[i] += _mm512_reduce_add_ps(close_dx);
+	own->close_dy[i] += _mm512_reduce_add_ps(close_dy);
+	own->avg_x[i] += _mm512_reduce_add_ps(avg_x);
+	own->avg_y[i] += _mm512_reduce_add_ps(avg_y);
+	own->avg_vx[i] += _mm512_reduce_add_ps(avg_vx);
+	own->avg_vy[i] += _mm512_reduce_add_ps(avg_vy);
+	own->visible_count[i] += visible_count;
+}
+
+// See integrate_avx2(). Byte loads need AVX512BW, so the boids past the last
+// full vector go through the scalar loop.
+static void integrate_avx512(const struct SimParams *p, const struct BoidState *front, struct BoidState *back,
+	const uint8_t *group, int begin, int end) {
+	__m512 zero = _mm512_setzero_ps();
+	__m512 one = _mm512_set1_ps(1);
+	__m512 minus_one = _mm512_set1_ps(-1);
+	__m512 max_bias = _mm512_set1_ps(p->max_bias);
+	__m512 increment = _mm512_set1_ps(p->bias_increment);
+	__m512 min_speed = _mm512_set1_ps(p->min_speed);
+	__m512 max_speed = _mm512_set1_ps(p->max_speed);
+	__m512i axis_bit = _mm512_set1_epi32(2);
+	__m512i sign_bit = _mm512_set1_epi32(1);
+	int i = begin;
+
+	for (; i + 16 <= end; i += 16) {
+		__m512 vx = _mm512_loadu_ps(&back->vx[i]);
+		__m512 vy = _mm512_loadu_ps(&back->vy[i]);
+		__m512 bias = _mm512_loadu_ps(&front->bias[i]);
+		__m512i g = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)&group[i]));
+
+		__mmask16 on_y = _mm512_test_epi32_mask(g, axis_bit);
+		__mmask16 negative = _mm512_test_epi32_mask(g, sign_bit);
+		__m512 sign = _mm512_mask_blend_ps(negative, one, minus_one);
+		__m512 v = _mm512_mask_blend_ps(on_y, vx, vy);
+
+		__mmask16 heading = _mm512_cmp_ps_mask(_mm512_mul_ps(sign, v), zero, _CMP_GT_OQ);
+		__m512 up = _mm512_min_ps(max_bias, _mm512_add_ps(bias, increment));
+		__m512 down = _mm512_max_ps(increment, _mm512_sub_ps(bias, increment));
+		bias = _mm512_mask_blend_ps(heading, down, up);
+
+		v = _mm512_add_ps(_mm512_mul_ps(_mm512_sub_ps(one, bias), v), _mm512_mul_ps(bias, sign));
+		vx = _mm512_mask_blend_ps(on_y, v, vx);
+		vy = _mm512_mask_blend_ps(on_y, vy, v);
+
+		__m512 speed = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(vx, vx), _mm512_mul_ps(vy, vy)));
+		__mmask16 slow = _mm512_cmp_ps_mask(speed, min_speed, _CMP_LT_OQ);
+		__mmask16 fast = _mm512_cmp_ps_mask(speed, max_speed, _CMP_GT_OQ);
+		__m512 limit = _mm512_mask_blend_ps(slow, max_speed, min_speed);
+
+		vx = _mm512_mask_mul_ps(vx, slow | fast, _mm512_div_ps(vx, speed), limit);
+		vy = _mm512_mask_mul_ps(vy, slow | fast, _mm512_div_ps(vy, speed), limit);
+
+		_mm512_storeu_ps(&back->x[i], _mm512_add_ps(_mm512_loadu_ps(&front->x[i]), vx));
+		_mm512_storeu_ps(&back->y[i], _mm512_add_ps(_mm512_loadu_ps(&front->y[i]), vy));
+		_mm512_storeu_ps(&back->vx[i], vx);
+		_mm512_storeu_ps(&back->vy[i], vy);
+		_mm512_storeu_ps(&back->bias[i], bias);
+	}
+
+	kernels_integrate_scalar(p, front, back, group, i, end);
+}
+
+static inline __m512 lerp_512(const float *prev, const float *cur, __m512 alpha) {
+	__m512 p = _mm512_loadu_ps(prev);
+
+	return _mm512_add_ps(p, _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(cur), p), alpha));
+}
+
+// Writes the four boids of each 128-bit lane, boid k of the lane in out[4 * k].
+static inline void store_boids_512(float *out, __m512 x, __m512 y, __m512 vx, __m512 vy) {
+	__m512 xy_lo = _mm512_unpacklo_ps(x, y);
+	__m512 xy_hi = _mm512_unpackhi_ps(x, y);
+	__m512 v_lo = _mm512_unpacklo_ps(vx, vy);
+	__m512 v_hi = _mm512_unpackhi_ps(vx, vy);
+
+	__m512 b0 = _mm512_shuffle_ps(xy_lo, v_lo, _MM_SHUFFLE(1, 0, 1, 0));
+	__m512 b1 = _mm512_shuffle_ps(xy_lo, v_lo, _MM_SHUFFLE(3, 2, 3, 2));
+	__m512 b2 = _mm512_shuffle_ps(xy_hi, v_hi, _MM_SHUFFLE(1, 0, 1, 0));
+	__m512 b3 = _mm512_shuffle_ps(xy_hi, v_hi, _MM_SHUFFLE(3, 2, 3, 2));
+
+	// Boids 4l..4l+3 from the l-th 128-bit lane of b0..b3.
+	__m512 b01_lo = _mm512_shuffle_f32x4(b0, b1, _MM_SHUFFLE(1, 0, 1, 0));
+	__m512 b23_lo = _mm512_shuffle_f32x4(b2, b3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m512 b01_hi = _mm512_shuffle_f32x4(b0, b1, _MM_SHUFFLE(3, 2, 3, 2));
+	__m512 b23_hi = _mm512_shuffle_f32x4(b2, b3, _MM_SHUFFLE(3, 2, 3, 2));
+
+	_mm512_storeu_ps(&out[0], _mm512_shuffle_f32x4(b01_lo, b23_lo, _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm512_storeu_ps(&out[16], _mm512_shuffle_f32x4(b01_lo, b23_lo, _MM_SHUFFLE(3, 1, 3, 1)));
+	_mm512_storeu_ps(&out[32], _mm512_shuffle_f32x4(b01_hi, b23_hi, _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm512_storeu_ps(&out[48], _mm512_shuffle_f32x4(b01_hi, b23_hi, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+static void fill_instances_avx512(float *out, const struct BoidState *prev, const struct BoidState *cur, float alpha, int len) {
+	__m512 a = _mm512_set1_ps(alpha);
+	int i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m512 x = lerp_512(&prev->x[i], &cur->x[i], a);
+		__m512 y = lerp_512(&prev->y[i], &cur->y[i], a);
+		__m512 vx = lerp_512(&prev->vx[i], &cur->vx[i], a);
+		__m512 vy = lerp_512(&prev->vy[i], &cur->vy[i], a);
+
+		store_boids_512(&out[4 * i], x, y, vx, vy);
+	}
+
+	kernels_fill_instances_scalar(out, prev, cur, alpha, i, len);
+}
+
+const struct Kernels kernels_avx512 = {
+	.isa = "avx512",
+	.neighbors = neighbors_avx512,
+	.pairs = pairs_avx512,
+	.integrate = integrate_avx512,
+	.fill_instances = fill_instances_avx512,
+};
@@ -0,0 +1,109 @@
+#include <immintrin.h>
+#include "kernels.h"
+
+// The x86-64 baseline. Without blends the integration branches are cheaper
+// than their masks, so it stays scalar, as does the pair pass.
+
+static inline float sum_128(__m128 v) {
+	__m128 hi = _mm_movehl_ps(v, v);
+	v = _mm_add_ps(v, hi);
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+
+	return _mm_cvtss_f32(v);
+}
+
+static void neighbors_sse2(const int *ids, const float *xs, const float *ys, int len, void *data) {
+	if (len < 4) {
+		kernels_neighbors_scalar(ids, xs, ys, len, data);
+		return;
+	}
+
+	struct Neighborhood *n = data;
+
+	__m128 x = _mm_set1_ps(n->x);
+	__m128 y = _mm_set1_ps(n->y);
+	__m128 visible2 = _mm_set1_ps(n->visible2);
+	__m128 protected2 = _mm_set1_ps(n->protected2);
+
+	__m128 close_dx = _mm_setzero_ps(), close_dy = _mm_setzero_ps();
+	__m128 avg_x = _mm_setzero_ps(), avg_y = _mm_setzero_ps();
+	__m128 avg_vx = _mm_setzero_ps(), avg_vy = _mm_setzero_ps();
+	int visible_count = 0;
+	int j = 0;
+
+	for (; j + 4 <= len; j += 4) {
+		__m128 xj = _mm_loadu_ps(&xs[j]);
+		__m128 yj = _mm_loadu_ps(&ys[j]);
+		__m128 dx = _mm_sub_ps(x, xj);
+		__m128 dy = _mm_sub_ps(y, yj);
+		__m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+		__m128 in_visible = _mm_cmplt_ps(distance, visible2);
+		__m128 in_protected = _mm_cmplt_ps(distance, protected2);
+		__m128 close = _mm_and_ps(in_visible, in_protected);
+		__m128 visible = _mm_andnot_ps(in_protected, in_visible);
+
+		int mask = _mm_movemask_ps(visible);
+
+		close_dx = _mm_add_ps(close_dx, _mm_and_ps(close, dx));
+		close_dy = _mm_add_ps(close_dy, _mm_and_ps(close, dy));
+
+		if (mask == 0) {
+			continue;
+		}
+
+		// No gathers before AVX2.
+		__m128 vx = _mm_setr_ps(n->vx[ids[j]], n->vx[ids[j + 1]], n->vx[ids[j + 2]], n->vx[ids[j + 3]]);
+		__m128 vy = _mm_setr_ps(n->vy[ids[j]], n->vy[ids[j + 1]], n->vy[ids[j + 2]], n->vy[ids[j + 3]]);
+
+		avg_x = _mm_add_ps(avg_x, _mm_and_ps(visible, xj));
+		avg_y = _mm_add_ps(avg_y, _mm_and_ps(visible, yj));
+		avg_vx = _mm_add_ps(avg_vx, _mm_and_ps(visible, vx));
+		avg_vy = _mm_add_ps(avg_vy, _mm_and_ps(visible, vy));
+		visible_count += __builtin_popcount(mask);
+	}
+
+	n->close_dx += sum_128(close_dx);
+	n->close_dy += sum_128(close_dy);
+	n->avg_x += sum_128(avg_x);
+	n->avg_y += sum_128(avg_y);
+	n->avg_vx += sum_128(avg_vx);
+	n->avg_vy += sum_128(avg_vy);
+	n->visible_count += visible_count;
+
+	kernels_neighbors_scalar(ids + j, xs + j, ys + j, len - j, data);
+}
+
+static void fill_instances_sse2(float *out, const struct BoidState *prev, const struct BoidState *cur, float alpha, int len) {
+	__m128 a = _mm_set1_ps(alpha);
+	int i = 0;
+
+	for (; i + 4 <= len; i += 4) {
+		__m128 px = _mm_loadu_ps(&prev->x[i]);
+		__m128 py = _mm_loadu_ps(&prev->y[i]);
+		__m128 pvx = _mm_loadu_ps(&prev->vx[i]);
+		__m128 pvy = _mm_loadu_ps(&prev->vy[i]);
+
+		__m128 x = _mm_add_ps(px, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cur->x[i]), px), a));
+		__m128 y = _mm_add_ps(py, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cur->y[i]), py), a));
+		__m128 vx = _mm_add_ps(pvx, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cur->vx[i]), pvx), a));
+		__m128 vy = _mm_add_ps(pvy, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cur->vy[i]), pvy), a));
+
+		_MM_TRANSPOSE4_PS(x, y, vx, vy);
+
+		_mm_storeu_ps(&out[4 * i + 0], x);
+		_mm_storeu_ps(&out[4 * i + 4], y);
+		_mm_storeu_ps(&out[4 * i + 8], vx);
+		_mm_storeu_ps(&out[4 * i + 12], vy);
+	}
+
+	kernels_fill_instances_scalar(out, prev, cur, alpha, i, len);
+}
+
+const struct Kernels kernels_sse2 = {
+	.isa = "sse2",
+	.neighbors = neighbors_sse2,
+	.pairs = kernels_pairs_scalar,
+	.integrate = kernels_integrate_scalar,
+	.fill_instances = fill_instances_sse2,
+};
@@ -1,12 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 #include <cglm/struct.h>
 #include "nuklear.h"
-#include "quadtree.h"
+#include "sim.h"
+#include "kernels.h"
+#include "simjob.h"
+#include "workers.h"
+#include "trace.h"
+#include "scaling.h"
+#include "profiler.h"
+#include "ringbuf.h"
+#include "gputimer.h"
 #include "shader.h"
 
 int scr_width = 1280;
@@ -15,30 +25,18 @@ int scr_height = 720;
 float boid_size = 20.0f;
 int boid_count = 5000;
 
-float protected_range = 8.0f;
-float visible_range = 40.0f;
-float seperation_fct = 0.05f;
-float alignment_fct = 0.05f;
-float cohesion_fct = 0.0005f;
-float turn_fct = 0.2f;
-float max_speed = 6.0f;
-float min_speed = 3.0f;
-float max_bias = 0.01f;
-float bias_increment = 0.00004f;
-
-enum Group {
-	RIGHT = 0,
-	LEFT,
-	BOTTOM,
-	TOP,
-};
-
-struct Boid {
-	vec3s pos;
-	vec3s vel;
-
-	float bias;
-	enum Group group;
+// Steps run at a fixed rate whatever the frame rate. A frame runs at most
+// MAX_CATCHUP_STEPS steps, the simulation slows down rather than spiral when
+// it cannot keep up.
+#define MAX_CATCHUP_STEPS 4
+const double step_dt = 1.0 / SIM_STEP_RATE;
+uint64_t seed;
+
+vec4 palette[] = {
+	[RIGHT] = {0.0f, 1.0f, 1.0f, 1.0f},
+	[LEFT] = {1.0f, 0.0f, 1.0f, 1.0f},
+	[BOTTOM] = {1.0f, 1.0f, 0.0f, 1.0f},
+	[TOP] = {1.0f, 0.5f, 0.0f, 1.0f},
 };
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
@@ -53,60 +51,69 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	}
 }
 
-void init_boids(struct Boid **boids, GLuint *boid_vao, GLuint *model_vbo, GLuint *color_vbo) {
-	*boids = calloc(boid_count, sizeof(struct Boid));
-	if (boids == NULL) {
-		fprintf(stderr, "Error while allocating memory");
-		abort();
-	}
-
+// Every instance is a vec4 of position and velocity, the vertex shader
+// builds the model transform from it. The instance attribute is pointed at
+// the ring buffer region of the frame right before every draw.
+void init_boid_buffers(struct Sim *sim, GLuint *boid_vao, struct RingBuffer *instance_ring, GLuint *group_vbo) {
 	glBindVertexArray(*boid_vao);
-	glBindBuffer(GL_ARRAY_BUFFER, *model_vbo);
-	glBufferData(GL_ARRAY_BUFFER, boid_count * sizeof(mat4), NULL, GL_DYNAMIC_DRAW);
+	ringbuf_init(instance_ring, sim->len * sizeof(vec4));
 
 	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glEnableVertexAttribArray(3);
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)0);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(sizeof(float) * 4));
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(sizeof(float) * 8));
-	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(sizeof(float) * 12));
 	glVertexAttribDivisor(1, 1);
-	glVertexAttribDivisor(2, 1);
-	glVertexAttribDivisor(3, 1);
-	glVertexAttribDivisor(4, 1);
-
-	glBindBuffer(GL_ARRAY_BUFFER, *color_vbo);
-	glBufferData(GL_ARRAY_BUFFER, boid_count * sizeof(vec4), NULL, GL_STATIC_DRAW);
-
-	for (int i = 0; i < boid_count; i++) {
-		struct Boid *boid = &(*boids)[i];
-		boid->bias = 0.001;
-		boid->group = i % 4;
-
-		if (boid->group == RIGHT) {
-			glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(vec4), sizeof(vec4), (vec4){0.0f, 1.0f, 1.0f, 1.0f});
-		} else if (boid->group == LEFT) {
-			glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(vec4), sizeof(vec4), (vec4){1.0f, 0.0f, 1.0f, 1.0f});
-		} else if (boid->group == BOTTOM) {
-			glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(vec4), sizeof(vec4), (vec4){1.0f, 1.0f, 0.0f, 1.0f});
-		} else if (boid->group == TOP) {
-			glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(vec4), sizeof(vec4), (vec4){1.0f, 0.5f, 0.0f, 1.0f});
-		}
 
-		boid->pos.x = (scr_width / 2.0f) - (boid_size / 2);
-		boid->pos.x += 100 * ((((float)rand() / RAND_MAX) * 2.0f) - 1.0f);
-		boid->pos.y = (scr_height / 2.0f) - (boid_size / 2);
-		boid->pos.y += 100 * ((((float)rand() / RAND_MAX) * 2.0f) - 1.0f);
-	}
+	// One byte per boid, the shader looks the color up in the palette.
+	glBindBuffer(GL_ARRAY_BUFFER, *group_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sim->len * sizeof(uint8_t), sim->group, GL_STATIC_DRAW);
 
-	glEnableVertexAttribArray(5);
-	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*)0);
-	glVertexAttribDivisor(5, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, sizeof(uint8_t), (void*)0);
+	glVertexAttribDivisor(2, 1);
+}
+
+void spawn_boids(struct Sim *sim) {
+	sim_spawn(sim, (scr_width / 2.0f) - (boid_size / 2), (scr_height / 2.0f) - (boid_size / 2), 100, seed);
 }
 
 int main(int argc, char **argv) {
+	int threads = workers_default_count();
+	const struct SpatialIndex *spatial_index = &quadtree_index;
+	const char *trace_path = NULL;
+	bool bench_scaling = false;
+	bool pairwise = false;
+	int bench_steps = 20;
+	seed = time(NULL);
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+			spatial_index = spatial_find(argv[++i]);
+			if (spatial_index == NULL) {
+				fprintf(stderr, "unknown spatial index: %s", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace_path = argv[++i];
+		} else if (strcmp(argv[i], "--pairs") == 0) {
+			pairwise = true;
+		} else if (strcmp(argv[i], "--bench-scaling") == 0) {
+			bench_scaling = true;
+		} else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+			bench_steps = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--index quadtree|quadtree-inc|grid] [--pairs] [--threads N] [--seed N] [--trace FILE] [--bench-scaling [--steps N]]", argv[0]);
+			return -1;
+		}
+	}
+
+	// Runs without ever opening a window, --threads caps the sweep.
+	if (bench_scaling) {
+		scaling_run(stdout, spatial_index, threads < 1 ? 1 : threads, bench_steps < 1 ? 1 : bench_steps);
+		return 0;
+	}
+
 	if (!glfwInit()) {
 		fprintf(stderr, "failed to initialize glfw");
 		return -1;
@@ -134,16 +141,19 @@ int main(int argc, char **argv) {
 	Shader shader_pg;
 	shader_init(&shader_pg, "assets/shader.vert", "assets/shader.frag");
 
+	glUseProgram(shader_pg);
+	shader_set_vec4v(shader_pg, "palette", 4, palette);
+
 	float vertices[] = {
 		0.5f, 0.0f,
 		0.0f, 1.0f,
 		1.0f, 1.0f,
 	};
 
-	GLuint boid_vao, vert_vbo, model_vbo, color_vbo;
+	GLuint boid_vao, vert_vbo, group_vbo;
+	struct RingBuffer instance_ring;
 	glGenBuffers(1, &vert_vbo);
-	glGenBuffers(1, &model_vbo);
-	glGenBuffers(1, &color_vbo);
+	glGenBuffers(1, &group_vbo);
 	glGenVertexArrays(1, &boid_vao);
 
 	glBindVertexArray(boid_vao);
@@ -157,199 +167,197 @@ int main(int argc, char **argv) {
 	nk_glfw3_font_stash_begin(&atlas);
 	nk_glfw3_font_stash_end();
 
-	srand(time(NULL));
-	struct Boid *boids;
-	init_boids(&boids, &boid_vao, &model_vbo, &color_vbo);
-
-	qt_pool_init(boid_count);
-
-	while(!glfwWindowShouldClose(window)) {
-		struct Quad *root = qt_pool_get(true);
-		quad_init(root, 0, 0, scr_width, scr_height, 0);
-
-		for (int i = 0; i < boid_count; i++) {
-			struct Boid *boid = &boids[i];
-
-			float x = glm_max(0, boid->pos.x);
-			float y = glm_max(0, boid->pos.y);
-
-			x = glm_min(x, scr_width - 1);
-			y = glm_min(y, scr_height - 1);
-
-			struct Quad *q = quad_search(root, x, y);
-			quad_insert(q, boid, x, y);
-		}
-
-		for (int i = 0; i < boid_count; i++) {
-			struct Boid *boid = &boids[i];
+	if (trace_path != NULL && !trace_open(trace_path)) {
+		fprintf(stderr, "failed to open trace file: %s", trace_path);
+		return -1;
+	}
 
-			vec3s avg_pos = {0}, avg_vel = {0}, close_d = {0};
+	workers_init(threads);
 
-			float x = glm_max(0, boid->pos.x);
-			float y = glm_max(0, boid->pos.y);
+	printf("seed: %llu\n", (unsigned long long)seed);
+	struct Sim sim = {.params = sim_default_params, .pairwise = pairwise};
+	sim_init(&sim, boid_count, spatial_index);
+	spawn_boids(&sim);
+	init_boid_buffers(&sim, &boid_vao, &instance_ring, &group_vbo);
 
-			x = glm_min(x, scr_width - 1);
-			y = glm_min(y, scr_height - 1);
+	struct GpuTimer gpu_timer;
+	gputimer_init(&gpu_timer);
 
-			struct Quad* q = quad_search(root, x, y);
-			int visible_count = 0;
+	struct SimJob sim_job;
+	simjob_init(&sim_job, &sim);
 
-			for (int j = 0; j < q->items_len; j++) {
-				struct Boid *boid_o = q->items[j].item;
+	double last_time = glfwGetTime();
+	double accumulator = 0;
+	uint32_t group_order = sim.order;
 
-				float distance = fabsf(glms_vec3_distance2(boid->pos, boid_o->pos));
+	while(!glfwWindowShouldClose(window)) {
+		PROF_BEGIN(PROF_FRAME);
+		GPU_PROF_COLLECT(&gpu_timer);
 
-				if (distance < visible_range * visible_range) {
-					if (distance < protected_range * protected_range) {
-						close_d = glms_vec3_add(close_d, glms_vec3_sub(boid->pos, boid_o->pos));
-					} else {
-						avg_pos = glms_vec3_add(avg_pos, boid_o->pos);
-						avg_vel = glms_vec3_add(avg_vel, boid_o->vel);
+		// The steps started last frame ran while it was being drawn.
+		PROF_BEGIN(PROF_SIM_WAIT);
+		simjob_wait(&sim_job);
+		PROF_END(PROF_SIM_WAIT);
 
-						visible_count++;
-					}
-				}
-			}
+		double now = glfwGetTime();
+		accumulator += now - last_time;
+		last_time = now;
 
-			if (visible_count > 0) {
-				avg_pos = glms_vec3_divs(avg_pos, visible_count);
-				avg_vel = glms_vec3_divs(avg_vel, visible_count);
+		sim.params.width = scr_width;
+		sim.params.height = scr_height;
 
-				boid->vel = glms_vec3_add(boid->vel, glms_vec3_add(glms_vec3_scale(glms_vec3_sub(avg_pos, boid->pos), cohesion_fct), glms_vec3_scale(glms_vec3_sub(avg_vel, boid->vel), alignment_fct)));
-			}
+		int steps = 0;
+		while (accumulator >= step_dt && steps < MAX_CATCHUP_STEPS) {
+			accumulator -= step_dt;
+			steps++;
+		}
 
-			boid->vel = glms_vec3_add(boid->vel, glms_vec3_scale(close_d, seperation_fct));
+		if (accumulator >= step_dt) {
+			accumulator = fmod(accumulator, step_dt);
+		}
 
-			if (boid->pos.y < 100) {
-				boid->vel.y += turn_fct;
-			} else if (boid->pos.y > scr_height - 100) {
-				boid->vel.y -= turn_fct;
-			}
+		// Render in between the last two steps, which were completed by the
+		// previous frame, while this frame's steps run on the simulation
+		// thread.
+		sim_pin(&sim);
+		struct BoidState *front = sim_front(&sim);
+		struct BoidState *prev = sim_prev(&sim);
+		float alpha = accumulator / step_dt;
+
+		// The pinned states are in the latest order, the groups have to
+		// follow when it changed.
+		if (sim.order != group_order) {
+			glBindBuffer(GL_ARRAY_BUFFER, group_vbo);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sim.len * sizeof(uint8_t), sim.group);
+			group_order = sim.order;
+		}
 
-			if (boid->pos.x < 100) {
-				boid->vel.x += turn_fct;
-			} else if (boid->pos.x > scr_width - 100) {
-				boid->vel.x -= turn_fct;
-			}
+		nk_glfw3_new_frame();
 
-			if (boid->group == RIGHT) {
-				if (boid->vel.x > 0) {
-					boid->bias = glm_min(max_bias, boid->bias + bias_increment);
-				} else {
-					boid->bias = glm_max(bias_increment, boid->bias - bias_increment);
-				}
-			} else if (boid->group == LEFT) {
-				if (boid->vel.x < 0) {
-					boid->bias = glm_min(max_bias, boid->bias + bias_increment);
-				} else {
-					boid->bias = glm_max(bias_increment, boid->bias - bias_increment);
-				}
-			} else if (boid->group == BOTTOM) {
-				if (boid->vel.y > 0) {
-					boid->bias = glm_min(max_bias, boid->bias + bias_increment);
-				} else {
-					boid->bias = glm_max(bias_increment, boid->bias - bias_increment);
-				}
-			} else if (boid->group == TOP) {
-				if (boid->vel.y < 0) {
-					boid->bias = glm_min(max_bias, boid->bias + bias_increment);
-				} else {
-					boid->bias = glm_max(bias_increment, boid->bias - bias_increment);
+		if (nk_begin(ctx, "Options", nk_rect(0, 0, 250, scr_height), NK_WINDOW_DYNAMIC|NK_WINDOW_MOVABLE|NK_WINDOW_MINIMIZABLE)) {
+			nk_layout_row_dynamic(ctx, 0, spatial_indices_len);
+			for (int i = 0; i < spatial_indices_len; i++) {
+				if (nk_option_label(ctx, spatial_indices[i]->name, sim.index == spatial_indices[i])) {
+					sim_set_index(&sim, spatial_indices[i]);
 				}
 			}
 
-			if (boid->group == RIGHT) {
-				boid->vel.x = (1 - boid->bias)*boid->vel.x + (boid->bias * 1);
-			} else if (boid->group == LEFT) {
-				boid->vel.x = (1 - boid->bias)*boid->vel.x + (boid->bias * -1);
-			} else if (boid->group == BOTTOM) {
-				boid->vel.y = (1 - boid->bias)*boid->vel.y + (boid->bias * 1);
-			} else if (boid->group == TOP) {
-				boid->vel.y = (1 - boid->bias)*boid->vel.y + (boid->bias * -1);
-			}
-
-			float speed = glms_vec3_distance((vec3s){0}, boid->vel);
-
-			if (speed < min_speed) {
-				boid->vel = glms_vec3_scale(glms_vec3_divs(boid->vel, speed), min_speed);
-			} else if (speed > max_speed) {
-				boid->vel = glms_vec3_scale(glms_vec3_divs(boid->vel, speed), max_speed);
+			// The pair pass does not use the index.
+			nk_layout_row_dynamic(ctx, 0, 1);
+			nk_bool pairs = sim.pairwise;
+			if (nk_checkbox_label(ctx, "Pairwise neighbors", &pairs)) {
+				sim.pairwise = pairs;
 			}
 
-			boid->pos = glms_vec3_add(boid->pos, boid->vel);
-		}
-
-		nk_glfw3_new_frame();
-
-		if (nk_begin(ctx, "Options", nk_rect(0, 0, 250, scr_height), NK_WINDOW_DYNAMIC|NK_WINDOW_MOVABLE|NK_WINDOW_MINIMIZABLE)) {
 			nk_layout_row_dynamic(ctx, 0, 1);
-			nk_property_float(ctx, "Protected range", 0.0f, &protected_range, 100.0f, 1.0f, 0.5f);
-			nk_property_float(ctx, "Visible range", 0.0f, &visible_range, 100.0f, 1.0f, 0.5f);
-			nk_property_float(ctx, "Seperation factor", 0.0f, &seperation_fct, 1.0f, 0.01f, 0.005f);
-			nk_property_float(ctx, "Alignment factor", 0.0f, &alignment_fct, 1.0f, 0.01f, 0.005f);
-			nk_property_float(ctx, "Cohesion factor", 0.0f, &cohesion_fct, 1.0f, 0.0001f, 0.00005f);
-			nk_property_float(ctx, "Turn factor", 0.0f, &turn_fct, 1.0f, 0.1f, 0.05f);
-			nk_property_float(ctx, "Max speed", 0.0f, &max_speed, 100.0f, 1.0f, 0.5f);
-			nk_property_float(ctx, "Min speed", 0.0f, &min_speed, 100.0f, 1.0f, 0.5f);
-			nk_property_float(ctx, "Max bias", 0.0f, &max_bias, 1.0f, 0.01f, 0.005f);
-			nk_property_float(ctx, "Bias increment", 0.0f, &bias_increment, 1.0f, 0.00001f, 0.000005f);
+			nk_property_float(ctx, "Protected range", 0.0f, &sim.params.protected_range, 100.0f, 1.0f, 0.5f);
+			nk_property_float(ctx, "Visible range", 0.0f, &sim.params.visible_range, 100.0f, 1.0f, 0.5f);
+			nk_property_float(ctx, "Seperation factor", 0.0f, &sim.params.seperation_fct, 1.0f, 0.01f, 0.005f);
+			nk_property_float(ctx, "Alignment factor", 0.0f, &sim.params.alignment_fct, 1.0f, 0.01f, 0.005f);
+			nk_property_float(ctx, "Cohesion factor", 0.0f, &sim.params.cohesion_fct, 1.0f, 0.0001f, 0.00005f);
+			nk_property_float(ctx, "Turn factor", 0.0f, &sim.params.turn_fct, 1.0f, 0.1f, 0.05f);
+			nk_property_float(ctx, "Max speed", 0.0f, &sim.params.max_speed, 100.0f, 1.0f, 0.5f);
+			nk_property_float(ctx, "Min speed", 0.0f, &sim.params.min_speed, 100.0f, 1.0f, 0.5f);
+			nk_property_float(ctx, "Max bias", 0.0f, &sim.params.max_bias, 1.0f, 0.01f, 0.005f);
+			nk_property_float(ctx, "Bias increment", 0.0f, &sim.params.bias_increment, 1.0f, 0.00001f, 0.000005f);
 
 			int new_boid_count = nk_propertyi(ctx, "No. of boids", 10, boid_count, 1000000, 10, 5);
 			if (new_boid_count != boid_count) {
 				boid_count = new_boid_count;
 
-				free(boids);
-				init_boids(&boids, &boid_vao, &model_vbo, &color_vbo);
-
-				qt_pool_free();
-				qt_pool_init(boid_count);
+				const struct SpatialIndex *index = sim.index;
+				sim_free(&sim);
+				ringbuf_free(&instance_ring);
+				sim_init(&sim, boid_count, index);
+				spawn_boids(&sim);
+				init_boid_buffers(&sim, &boid_vao, &instance_ring, &group_vbo);
 
 				nk_end(ctx);
 				nk_glfw3_render(NK_ANTI_ALIASING_ON);
 				continue;
 			}
+
+			struct SpatialStats stats;
+			sim.index->stats(&stats);
+			nk_labelf(ctx, NK_TEXT_LEFT, "Index: %d nodes, %.2f MB", stats.nodes, stats.bytes / (1024.0f * 1024.0f));
+
+			if (nk_tree_push(ctx, NK_TREE_TAB, "Performance", NK_MINIMIZED)) {
+#ifdef BOIDS_PROFILE
+				nk_layout_row_dynamic(ctx, 0, 4);
+				nk_label(ctx, "ms", NK_TEXT_LEFT);
+				nk_label(ctx, "min", NK_TEXT_RIGHT);
+				nk_label(ctx, "avg", NK_TEXT_RIGHT);
+				nk_label(ctx, "p99", NK_TEXT_RIGHT);
+
+				for (int i = 0; i < PROF_PHASES; i++) {
+					struct ProfStats ps;
+					prof_stats(i, &ps);
+
+					nk_label(ctx, prof_phase_names[i], NK_TEXT_LEFT);
+					nk_labelf(ctx, NK_TEXT_RIGHT, "%.3f", ps.min / 1e6);
+					nk_labelf(ctx, NK_TEXT_RIGHT, "%.3f", ps.avg / 1e6);
+					nk_labelf(ctx, NK_TEXT_RIGHT, "%.3f", ps.p99 / 1e6);
+				}
+#else
+				nk_layout_row_dynamic(ctx, 0, 1);
+				nk_label(ctx, "Profiling disabled", NK_TEXT_LEFT);
+#endif
+				nk_tree_pop(ctx);
+			}
 		}
 
 		nk_end(ctx);
 
+		simjob_start(&sim_job, steps);
+
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		glUseProgram(shader_pg);
 		glBindVertexArray(boid_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, model_vbo);
 
-		mat4 model, projection;
+		mat4 projection;
 		glm_ortho(0.0f, scr_width, scr_height, 0.0f, -1.0f, 1.0f, projection);
 		shader_set_mat4(shader_pg, "projection", projection);
-
-		for (int i = 0; i < boid_count; i++) {
-			struct Boid *boid = &boids[i];
-
-			vec3 normed_vel;
-			glm_vec3_normalize_to(boid->vel.raw, normed_vel);
-
-			glm_mat4_identity(model);
-			glm_translate(model, boid->pos.raw);
-			glm_scale(model, (vec3){boid_size, boid_size, 0.0f});
-			glm_rotate(model, atan2(normed_vel[1], normed_vel[0]) + glm_rad(90), (vec3){0.0f, 0.0f, 1.0f});
-			glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(mat4), sizeof(mat4), model);
-		}
-
-		glDrawArraysInstanced(GL_TRIANGLES, 0, 3, boid_count);
-
+		shader_set_float(shader_pg, "boid_size", boid_size);
+
+		PROF_BEGIN(PROF_UPLOAD);
+		vec4 *instances = ringbuf_begin(&instance_ring);
+		kernels.fill_instances((float *)instances, prev, front, alpha, sim.len);
+		PROF_END(PROF_UPLOAD);
+
+		size_t offset = ringbuf_offset(&instance_ring);
+		glBindBuffer(GL_ARRAY_BUFFER, instance_ring.vbo);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*)offset);
+
+		PROF_BEGIN(PROF_DRAW);
+		GPU_PROF_BEGIN(&gpu_timer, PROF_DRAW_GPU);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 3, sim.len);
+		GPU_PROF_END(&gpu_timer);
+		ringbuf_end(&instance_ring);
+		PROF_END(PROF_DRAW);
+
+		PROF_BEGIN(PROF_UI);
+		GPU_PROF_BEGIN(&gpu_timer, PROF_UI_GPU);
 		nk_glfw3_render(NK_ANTI_ALIASING_ON);
+		GPU_PROF_END(&gpu_timer);
+		PROF_END(PROF_UI);
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		PROF_END(PROF_FRAME);
 	}
 
-	free(boids);
-	qt_pool_free();
+	simjob_free(&sim_job);
+	sim_free(&sim);
+	workers_free();
+	trace_close();
 
+	ringbuf_free(&instance_ring);
+	gputimer_free(&gpu_timer);
 	glDeleteBuffers(1, &vert_vbo);
-	glDeleteBuffers(1, &model_vbo);
-	glDeleteBuffers(1, &color_vbo);
+	glDeleteBuffers(1, &group_vbo);
 	glDeleteVertexArrays(1, &boid_vao);
 	glDeleteProgram(shader_pg);
 	nk_glfw3_shutdown();
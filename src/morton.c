@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "morton.h"
+#include "workers.h"
+
+// Spreads the low 16 bits of v over the even bits.
+static uint32_t morton_spread(uint32_t v) {
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+
+	return v;
+}
+
+static uint32_t morton_quantize(float v, float max) {
+	if (!(v > 0) || max <= 0) {
+		return 0;
+	}
+
+	return v >= max ? 0xffff : (uint32_t)(v / max * 0xffff);
+}
+
+// Points outside the bounds are clamped onto them.
+uint32_t morton_key(float x, float y, float w, float h) {
+	return morton_spread(morton_quantize(x, w)) | (morton_spread(morton_quantize(y, h)) << 1);
+}
+
+void morton_init(struct MortonSort *s, int cap) {
+	int chunks = (cap + MORTON_CHUNK - 1) / MORTON_CHUNK;
+
+	s->cap = cap;
+	for (int i = 0; i < 2; i++) {
+		s->keys[i] = calloc(cap, sizeof(uint32_t));
+		s->order[i] = calloc(cap, sizeof(int));
+		if (s->keys[i] == NULL || s->order[i] == NULL) {
+			fprintf(stderr, "Error while allocating sort buffers");
+			abort();
+		}
+	}
+
+	s->counts = calloc((chunks > 0 ? chunks : 1) * MORTON_BUCKETS, sizeof(int));
+	if (s->counts == NULL) {
+		fprintf(stderr, "Error while allocating sort buffers");
+		abort();
+	}
+}
+
+struct MortonPass {
+	struct MortonSort *s;
+	const float *x;
+	const float *y;
+	float w;
+	float h;
+	int src;
+	int shift;
+};
+
+static void morton_keys_chunk(int begin, int end, int worker, void *data) {
+	struct MortonPass *p = data;
+
+	for (int i = begin; i < end; i++) {
+		p->s->keys[0][i] = morton_key(p->x[i], p->y[i], p->w, p->h);
+		p->s->order[0][i] = i;
+	}
+}
+
+static void morton_count_chunk(int begin, int end, int worker, void *data) {
+	struct MortonPass *p = data;
+	const uint32_t *keys = p->s->keys[p->src];
+	int *counts = &p->s->counts[begin / MORTON_CHUNK * MORTON_BUCKETS];
+
+	memset(counts, 0, MORTON_BUCKETS * sizeof(int));
+	for (int i = begin; i < end; i++) {
+		counts[(keys[i] >> p->shift) & (MORTON_BUCKETS - 1)]++;
+	}
+}
+
+// After the prefix sum counts holds where every digit of the chunk starts.
+static void morton_scatter_chunk(int begin, int end, int worker, void *data) {
+	struct MortonPass *p = data;
+	const uint32_t *keys = p->s->keys[p->src];
+	const int *order = p->s->order[p->src];
+	uint32_t *dst_keys = p->s->keys[!p->src];
+	int *dst_order = p->s->order[!p->src];
+	int *counts = &p->s->counts[begin / MORTON_CHUNK * MORTON_BUCKETS];
+
+	for (int i = begin; i < end; i++) {
+		int j = counts[(keys[i] >> p->shift) & (MORTON_BUCKETS - 1)]++;
+
+		dst_keys[j] = keys[i];
+		dst_order[j] = order[i];
+	}
+}
+
+// Returns the sorted order: the i-th point along the curve is the order[i]-th
+// of x and y. The sort is stable, points with the same key keep their
+// relative order. The result is valid until the next call.
+const int *morton_sort(struct MortonSort *s, const float *x, const float *y, int len, float w, float h) {
+	if (len > s->cap) {
+		fprintf(stderr, "Sort buffers are full");
+		abort();
+	}
+
+	int chunks = (len + MORTON_CHUNK - 1) / MORTON_CHUNK;
+	struct MortonPass p = {s, x, y, w, h, 0, 0};
+
+	workers_run(len, MORTON_CHUNK, morton_keys_chunk, &p);
+
+	for (p.shift = 0; p.shift < 32; p.shift += MORTON_RADIX_BITS) {
+		workers_run(len, MORTON_CHUNK, morton_count_chunk, &p);
+
+		// Digit by digit, then chunk by chunk within a digit, which keeps the
+		// sort stable. A pass where every key has the same digit would not
+		// move anything and is skipped.
+		int offset = 0;
+		bool moves = true;
+
+		for (int d = 0; d < MORTON_BUCKETS; d++) {
+			int digit_begin = offset;
+
+			for (int c = 0; c < chunks; c++) {
+				int count = s->counts[c * MORTON_BUCKETS + d];
+
+				s->counts[c * MORTON_BUCKETS + d] = offset;
+				offset += count;
+			}
+
+			if (digit_begin == 0 && offset == len) {
+				moves = false;
+			}
+		}
+
+		if (moves) {
+			workers_run(len, MORTON_CHUNK, morton_scatter_chunk, &p);
+			p.src = !p.src;
+		}
+	}
+
+	return s->order[p.src];
+}
+
+void morton_free(struct MortonSort *s) {
+	for (int i = 0; i < 2; i++) {
+		free(s->keys[i]);
+		free(s->order[i]);
+		s->keys[i] = NULL;
+		s->order[i] = NULL;
+	}
+
+	free(s->counts);
+	s->counts = NULL;
+	s->cap = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <stdint.h>
+
+#define MORTON_RADIX_BITS 8
+#define MORTON_BUCKETS (1 << MORTON_RADIX_BITS)
+#define MORTON_CHUNK 4096
+
+// Sorts points along a Z-order curve, so that points close in space end up
+// close in the order. The sort is a least significant digit radix sort of
+// 32-bit keys, split in fixed chunks of MORTON_CHUNK points: every chunk
+// counts its digits in parallel, the counts are summed up in chunk order,
+// then every chunk scatters its points in parallel. The order only depends
+// on the points, not on the number of workers.
+struct MortonSort {
+	uint32_t *keys[2];
+	int *order[2];
+	int *counts;
+	int cap;
+};
+
+uint32_t morton_key(float x, float y, float w, float h);
+
+void morton_init(struct MortonSort *s, int cap);
+const int *morton_sort(struct MortonSort *s, const float *x, const float *y, int len, float w, float h);
+void morton_free(struct MortonSort *s);
+
+#endif
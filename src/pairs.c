@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pairs.h"
+#include "workers.h"
+
+static void pairs_alloc_sums(struct PairSums *s, int cap) {
+	s->close_dx = calloc(cap, sizeof(float));
+	s->close_dy = calloc(cap, sizeof(float));
+	s->avg_x = calloc(cap, sizeof(float));
+	s->avg_y = calloc(cap, sizeof(float));
+	s->avg_vx = calloc(cap, sizeof(float));
+	s->avg_vy = calloc(cap, sizeof(float));
+	s->visible_count = calloc(cap, sizeof(int));
+	if (s->close_dx == NULL || s->close_dy == NULL || s->avg_x == NULL || s->avg_y == NULL
+		|| s->avg_vx == NULL || s->avg_vy == NULL || s->visible_count == NULL) {
+		fprintf(stderr, "Error while allocating pair sums");
+		abort();
+	}
+}
+
+static void pairs_free_sums(struct PairSums *s) {
+	free(s->close_dx);
+	free(s->close_dy);
+	free(s->avg_x);
+	free(s->avg_y);
+	free(s->avg_vx);
+	free(s->avg_vy);
+	free(s->visible_count);
+	*s = (struct PairSums){0};
+}
+
+void pairs_init(struct Pairs *p, int cap) {
+	grid_init(&p->grid, 0, 0, GRID_MIN_CELL_SIZE, cap);
+
+	p->vx = calloc(cap, sizeof(float));
+	p->vy = calloc(cap, sizeof(float));
+	if (p->vx == NULL || p->vy == NULL) {
+		fprintf(stderr, "Error while allocating pair velocities");
+		abort();
+	}
+
+	pairs_alloc_sums(&p->sums, cap);
+	pairs_alloc_sums(&p->halo, cap);
+}
+
+struct PairsBuild {
+	struct Pairs *p;
+	const struct BoidState *front;
+};
+
+static void pairs_clear_sums(struct PairSums *s, int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		s->close_dx[i] = 0;
+		s->close_dy[i] = 0;
+		s->avg_x[i] = 0;
+		s->avg_y[i] = 0;
+		s->avg_vx[i] = 0;
+		s->avg_vy[i] = 0;
+		s->visible_count[i] = 0;
+	}
+}
+
+static void pairs_build_chunk(int begin, int end, int worker, void *data) {
+	struct PairsBuild *b = data;
+	struct Pairs *p = b->p;
+
+	for (int i = begin; i < end; i++) {
+		p->vx[i] = b->front->vx[p->grid.ids[i]];
+		p->vy[i] = b->front->vy[p->grid.ids[i]];
+	}
+
+	pairs_clear_sums(&p->sums, begin, end);
+	pairs_clear_sums(&p->halo, begin, end);
+}
+
+void pairs_build(struct Pairs *p, const struct BoidState *front, int len, float w, float h, float range) {
+	struct PairsBuild b = {p, front};
+
+	grid_resize(&p->grid, w, h, range);
+	grid_build(&p->grid, front->x, front->y, len);
+	workers_run(len, 0, pairs_build_chunk, &b);
+
+	p->points.x = p->grid.xs;
+	p->points.y = p->grid.ys;
+	p->points.vx = p->vx;
+	p->points.vy = p->vy;
+}
+
+static void pairs_rows(int begin, int end, int worker, void *data) {
+	struct Pairs *p = data;
+	struct Grid *g = &p->grid;
+
+	for (int row = begin; row < end; row++) {
+		for (int col = 0; col < g->cols; col++) {
+			int cell = row * g->cols + col;
+
+			// The rest of the cell and the next cell of the row follow each
+			// other, as do the three cells below.
+			int row_end = g->cell_start[col + 1 < g->cols ? cell + 2 : cell + 1];
+			int below_begin = 0;
+			int below_end = 0;
+
+			if (row + 1 < g->rows) {
+				int below = cell + g->cols;
+
+				below_begin = g->cell_start[col > 0 ? below - 1 : below];
+				below_end = g->cell_start[col + 1 < g->cols ? below + 2 : below + 1];
+			}
+
+			for (int i = g->cell_start[cell]; i < g->cell_start[cell + 1]; i++) {
+				kernels.pairs(&p->points, i, i + 1, row_end, &p->sums, &p->sums);
+				kernels.pairs(&p->points, i, below_begin, below_end, &p->sums, &p->halo);
+			}
+		}
+	}
+}
+
+void pairs_run(struct Pairs *p, float visible2, float protected2) {
+	p->points.visible2 = visible2;
+	p->points.protected2 = protected2;
+
+	workers_run(p->grid.rows, 1, pairs_rows, p);
+}
+
+// Sums up what the rows found for the boid in the given slot. A boid is
+// never paired with itself, its own contribution is added here as the
+// per-boid search would count it.
+void pairs_neighborhood(struct Pairs *p, int slot, struct Neighborhood *n) {
+	n->close_dx = p->sums.close_dx[slot] + p->halo.close_dx[slot];
+	n->close_dy = p->sums.close_dy[slot] + p->halo.close_dy[slot];
+	n->avg_x = p->sums.avg_x[slot] + p->halo.avg_x[slot];
+	n->avg_y = p->sums.avg_y[slot] + p->halo.avg_y[slot];
+	n->avg_vx = p->sums.avg_vx[slot] + p->halo.avg_vx[slot];
+	n->avg_vy = p->sums.avg_vy[slot] + p->halo.avg_vy[slot];
+	n->visible_count = p->sums.visible_count[slot] + p->halo.visible_count[slot];
+
+	if (0 < p->points.visible2 && !(0 < p->points.protected2)) {
+		n->avg_x += p->points.x[slot];
+		n->avg_y += p->points.y[slot];
+		n->avg_vx += p->points.vx[slot];
+		n->avg_vy += p->points.vy[slot];
+		n->visible_count++;
+	}
+}
+
+void pairs_free(struct Pairs *p) {
+	grid_free(&p->grid);
+
+	free(p->vx);
+	free(p->vy);
+	p->vx = NULL;
+	p->vy = NULL;
+
+	pairs_free_sums(&p->sums);
+	pairs_free_sums(&p->halo);
+}
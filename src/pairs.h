@@ -0,0 +1,34 @@
+#ifndef PAIRS_H
+#define PAIRS_H
+
+#include "grid.h"
+#include "kernels.h"
+#include "sim.h"
+
+// Finds every pair of boids within range once, instead of once from each
+// side, and adds its contribution to both boids' sums. The boids are
+// bucketed in a grid of cells at least the range wide, and every cell is
+// paired with itself and with the four cells after it: the next one in its
+// row and the three below it. Each row of cells is a task. The sums of a
+// row's own boids go to sums, those of the boids of the row below to halo,
+// so no two tasks ever write the same sum and the result does not depend
+// on the number of workers.
+struct Pairs {
+	struct Grid grid;
+
+	// Velocities in grid slot order.
+	float *vx;
+	float *vy;
+
+	struct PairPoints points;
+	struct PairSums sums;
+	struct PairSums halo;
+};
+
+void pairs_init(struct Pairs *p, int cap);
+void pairs_build(struct Pairs *p, const struct BoidState *front, int len, float w, float h, float range);
+void pairs_run(struct Pairs *p, float visible2, float protected2);
+void pairs_neighborhood(struct Pairs *p, int slot, struct Neighborhood *n);
+void pairs_free(struct Pairs *p);
+
+#endif
@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "profiler.h"
+#include "trace.h"
+
+const char *prof_phase_names[PROF_PHASES] = {
+	[PROF_INDEX_BUILD] = "Index build",
+	[PROF_NEIGHBORS] = "Neighbors",
+	[PROF_INTEGRATE] = "Integrate",
+	[PROF_SORT] = "Sort",
+	[PROF_SIM_WAIT] = "Sim wait",
+	[PROF_UPLOAD] = "Upload",
+	[PROF_DRAW] = "Draw",
+	[PROF_UI] = "UI",
+	[PROF_DRAW_GPU] = "Draw (GPU)",
+	[PROF_UI_GPU] = "UI (GPU)",
+	[PROF_FRAME] = "Frame",
+};
+
+struct ProfRing prof_rings[PROF_PHASES];
+
+uint64_t prof_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void prof_record(enum ProfPhase phase, uint64_t ns) {
+	struct ProfRing *r = &prof_rings[phase];
+
+	r->samples[r->head] = ns;
+	r->head = (r->head + 1) % PROF_SAMPLES;
+	if (r->len < PROF_SAMPLES) {
+		r->len++;
+	}
+}
+
+void prof_end(enum ProfPhase phase, uint64_t start) {
+	uint64_t end = prof_now();
+
+	prof_record(phase, end - start);
+	trace_event(prof_phase_names[phase], start, end, -1, -1);
+}
+
+static int prof_compare(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+void prof_stats(enum ProfPhase phase, struct ProfStats *stats) {
+	struct ProfRing *r = &prof_rings[phase];
+	uint64_t sorted[PROF_SAMPLES];
+	uint64_t sum = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	if (r->len == 0) {
+		return;
+	}
+
+	memcpy(sorted, r->samples, r->len * sizeof(uint64_t));
+	qsort(sorted, r->len, sizeof(uint64_t), prof_compare);
+
+	for (int i = 0; i < r->len; i++) {
+		sum += sorted[i];
+	}
+
+	stats->len = r->len;
+	stats->min = sorted[0];
+	stats->avg = (double)sum / r->len;
+	stats->p99 = sorted[(r->len * 99) / 100 < r->len ? (r->len * 99) / 100 : r->len - 1];
+}
@@ -0,0 +1,54 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+#define PROF_SAMPLES 256
+
+enum ProfPhase {
+	PROF_INDEX_BUILD = 0,
+	PROF_NEIGHBORS,
+	PROF_INTEGRATE,
+	PROF_SORT,
+	PROF_SIM_WAIT,
+	PROF_UPLOAD,
+	PROF_DRAW,
+	PROF_UI,
+	PROF_DRAW_GPU,
+	PROF_UI_GPU,
+	PROF_FRAME,
+	PROF_PHASES,
+};
+
+// Rolling window of the last PROF_SAMPLES durations of a phase, in ns.
+struct ProfRing {
+	uint64_t samples[PROF_SAMPLES];
+	int head;
+	int len;
+};
+
+struct ProfStats {
+	double min;
+	double avg;
+	double p99;
+	int len;
+};
+
+extern const char *prof_phase_names[PROF_PHASES];
+
+uint64_t prof_now();
+void prof_record(enum ProfPhase phase, uint64_t ns);
+void prof_end(enum ProfPhase phase, uint64_t start);
+void prof_stats(enum ProfPhase phase, struct ProfStats *stats);
+
+// Timers are compiled out entirely unless BOIDS_PROFILE is defined. When a
+// trace is being recorded every timed phase is also written to it.
+#ifdef BOIDS_PROFILE
+#define PROF_BEGIN(phase) uint64_t prof_start_##phase = prof_now()
+#define PROF_END(phase) prof_end(phase, prof_start_##phase)
+#else
+#define PROF_BEGIN(phase)
+#define PROF_END(phase)
+#endif
+
+#endif
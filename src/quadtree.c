@@ -5,138 +5,732 @@
 #include <string.h>
 #include "quadtree.h"
 
-void quad_init(struct Quad *q, float x, float y, float w, float h, int lvl) {
-	q->x = x;
-	q->y = y;
-	q->w = w;
-	q->h = h;
-	q->lvl = lvl;
-	q->subdivided = false;
+struct QuadPool qp;
+
+// Deep enough for a depth first walk: every level down leaves at most three
+// siblings behind.
+#define QUAD_STACK (3 * MAX_SUBLEVELS + 1)
+
+_Static_assert(MAX_SUBLEVELS <= 8, "quad columns and rows are stored in a byte");
+
+void quad_init(struct Quad *q, int lvl, int col, int row) {
+	q->children = 0;
+	q->parent = QUAD_NONE;
+	q->items_off = 0;
 	q->items_len = 0;
+	q->items_cap = 0;
+	q->lvl = lvl;
+	q->col = col;
+	q->row = row;
+}
+
+// Every edge is an integer multiple of the size of its level, and sizes only
+// differ by powers of two, so a quad's edges and the edges of its children
+// round to the very same floats.
+static float quad_left(struct Quad *q) {
+	return q->col * qp.quad_w[q->lvl];
+}
+
+static float quad_right(struct Quad *q) {
+	return (q->col + 1) * qp.quad_w[q->lvl];
+}
+
+static float quad_top(struct Quad *q) {
+	return q->row * qp.quad_h[q->lvl];
+}
+
+static float quad_bottom(struct Quad *q) {
+	return (q->row + 1) * qp.quad_h[q->lvl];
+}
+
+static float quad_mid_x(struct Quad *q) {
+	return (2 * q->col + 1) * qp.quad_w[q->lvl + 1];
+}
+
+static float quad_mid_y(struct Quad *q) {
+	return (2 * q->row + 1) * qp.quad_h[q->lvl + 1];
+}
+
+static struct Quad *quad_child(struct Quad *q, int i) {
+	return &qp.arr[q->children + i];
+}
+
+static struct Quad *quad_parent(struct Quad *q) {
+	return q->parent == QUAD_NONE ? NULL : &qp.arr[q->parent];
 }
 
-void quad_insert(struct Quad *q, void *item, float x, float y) {
+// Items are staged at the end of the arena and only distributed to the
+// children once quad_build() is called on the quad they were inserted into.
+void quad_insert(struct Quad *q, int id, float x, float y) {
 	assert(quad_is_inside(q, x, y));
+	assert(q->children == 0);
+	assert(q->items_off + q->items_len == qp.items_len);
 
-	if (q->items_len < 4 || q->lvl == MAX_SUBLEVELS) {
-		q->items[q->items_len++] = (struct QuadItem){item, x, y};
-	} else {
-		float w = q->w/2;
-		float h = q->h/2;
-		int lvl = q->lvl+1;
-
-		q->children[0] = qt_pool_get(false);
-		quad_init(q->children[0], q->x, q->y, w, h, lvl);
-		q->children[1] = qt_pool_get(false);
-		quad_init(q->children[1], q->x + w, q->y, w, h, lvl);
-		q->children[2] = qt_pool_get(false);
-		quad_init(q->children[2], q->x + w, q->y + h, w, h, lvl);
-		q->children[3] = qt_pool_get(false);
-		quad_init(q->children[3], q->x, q->y + h, w, h, lvl);
-
-		if (quad_is_inside(q->children[0], x, y)) {
-			quad_insert(q->children[0], item, x, y);
-		} else if (quad_is_inside(q->children[1], x, y)) {
-			quad_insert(q->children[1], item, x, y);
-		} else if (quad_is_inside(q->children[2], x, y)) {
-			quad_insert(q->children[2], item, x, y);
-		} else if (quad_is_inside(q->children[3], x, y)) {
-			quad_insert(q->children[3], item, x, y);
-		}
+	if (qp.items_len == qp.items_cap) {
+		fprintf(stderr, "Quad pool item arena is full");
+		abort();
+	}
 
-		for (int i = 0; i < q->items_len; i++) {
-			struct QuadItem item = q->items[i];
-
-			if (quad_is_inside(q->children[0], item.x, item.y)) {
-				quad_insert(q->children[0], item.item, item.x, item.y);
-			} else if (quad_is_inside(q->children[1], item.x, item.y)) {
-				quad_insert(q->children[1], item.item, item.x, item.y);
-			} else if (quad_is_inside(q->children[2], item.x, item.y)) {
-				quad_insert(q->children[2], item.item, item.x, item.y);
-			} else if (quad_is_inside(q->children[3], item.x, item.y)) {
-				quad_insert(q->children[3], item.item, item.x, item.y);
-			}
+	qp.ids[qp.items_len] = id;
+	qp.xs[qp.items_len] = x;
+	qp.ys[qp.items_len] = y;
+	qp.items_len++;
+	q->items_len++;
+	q->items_cap++;
+}
+
+static void quad_swap_items(int a, int b) {
+	int id = qp.ids[a];
+	float x = qp.xs[a];
+	float y = qp.ys[a];
+
+	qp.ids[a] = qp.ids[b];
+	qp.xs[a] = qp.xs[b];
+	qp.ys[a] = qp.ys[b];
+
+	qp.ids[b] = id;
+	qp.xs[b] = x;
+	qp.ys[b] = y;
+}
+
+static int quad_partition(int off, int len, bool by_x, float split) {
+	float *v = by_x ? qp.xs : qp.ys;
+	int i = off;
+	int j = off + len;
+
+	while (i < j) {
+		if (v[i] < split) {
+			i++;
+		} else {
+			quad_swap_items(i, --j);
 		}
+	}
+
+	return i - off;
+}
+
+// Gives a leaf its four children and shares its items out between them.
+// The range is split into top and bottom halves, then each half into its
+// left and right quadrants, so the children's items are packed from the
+// start of the range in the children's order.
+static void quad_divide(struct Quad *q) {
+	uint32_t self = q - qp.arr;
+	float mid_x = quad_mid_x(q);
+	float mid_y = quad_mid_y(q);
+
+	q->children = qt_pool_children();
+	for (int i = 0; i < 4; i++) {
+		struct Quad *c = quad_child(q, i);
+
+		quad_init(c, q->lvl + 1, 2 * q->col + (i & 1), 2 * q->row + (i >> 1));
+		c->parent = self;
+	}
+
+	int top = quad_partition(q->items_off, q->items_len, false, mid_y);
+	int top_left = quad_partition(q->items_off, top, true, mid_x);
+	int bottom_left = quad_partition(q->items_off + top, q->items_len - top, true, mid_x);
+
+	quad_child(q, 0)->items_len = top_left;
+	quad_child(q, 1)->items_len = top - top_left;
+	quad_child(q, 2)->items_len = bottom_left;
+	quad_child(q, 3)->items_len = q->items_len - top - bottom_left;
+
+	int off = q->items_off;
+	for (int i = 0; i < 4; i++) {
+		quad_child(q, i)->items_off = off;
+		off += quad_child(q, i)->items_len;
+	}
+}
+
+void quad_build(struct Quad *q) {
+	if (q->items_len <= QUAD_CAPACITY || q->lvl == MAX_SUBLEVELS) {
+		return;
+	}
+
+	quad_divide(q);
 
-		q->subdivided = true;
+	for (int i = 0; i < 4; i++) {
+		struct Quad *c = quad_child(q, i);
+
+		c->items_cap = c->items_len;
+		quad_build(c);
 	}
 }
 
 bool quad_is_inside(struct Quad *q, float x, float y) {
-	return x >= q->x && y >= q->y && x < q->x + q->w && y < q->y + q->h;
+	return x >= quad_left(q) && y >= quad_top(q) && x < quad_right(q) && y < quad_bottom(q);
 }
 
 struct Quad *quad_search(struct Quad *q, float x, float y) {
 	assert(quad_is_inside(q, x, y));
 
-	if (!q->subdivided || q->lvl == MAX_SUBLEVELS) {
-		return q;
+	while (q->children != 0) {
+		int right = x >= quad_mid_x(q);
+		int bottom = y >= quad_mid_y(q);
+
+		q = quad_child(q, right | bottom << 1);
 	}
 
-	if (x < q->x + (q->w / 2)) {
-		if (y < q->y + (q->h / 2)) {
-			return quad_search(q->children[0], x, y);
-		} else {
-			return quad_search(q->children[3], x, y);
+	return q;
+}
+
+static float quad_distance2(struct Quad *q, float x, float y) {
+	float near_x = fmaxf(quad_left(q) - x, fmaxf(0, x - quad_right(q)));
+	float near_y = fmaxf(quad_top(q) - y, fmaxf(0, y - quad_bottom(q)));
+
+	return near_x * near_x + near_y * near_y;
+}
+
+// Reports every quad intersecting the circle as one contiguous span of
+// items. Quads that lie entirely inside the circle are reported whole
+// instead of being descended into, as long as the arena is packed. Items of
+// a reported span may still lie outside the circle, callers are expected to
+// do their own distance test. Returns the number of quads visited.
+int quad_query_radius(struct Quad *q, float x, float y, float r, spatial_query_cb cb, void *data) {
+	uint32_t stack[QUAD_STACK];
+	int stack_len = 0;
+	int visited = 0;
+
+	stack[stack_len++] = q - qp.arr;
+
+	while (stack_len > 0) {
+		q = &qp.arr[stack[--stack_len]];
+		visited++;
+
+		if (q->items_len == 0) {
+			continue;
 		}
-	} else {
-		if (y < q->y + (q->h / 2)) {
-			return quad_search(q->children[1], x, y);
-		} else {
-			return quad_search(q->children[2], x, y);
+
+		float left = quad_left(q);
+		float right = quad_right(q);
+		float top = quad_top(q);
+		float bottom = quad_bottom(q);
+
+		float near_x = fmaxf(left - x, fmaxf(0, x - right));
+		float near_y = fmaxf(top - y, fmaxf(0, y - bottom));
+
+		if (near_x * near_x + near_y * near_y > r * r) {
+			continue;
+		}
+
+		float far_x = fmaxf(x - left, right - x);
+		float far_y = fmaxf(y - top, bottom - y);
+
+		if (q->children == 0 || (qp.packed && far_x * far_x + far_y * far_y <= r * r)) {
+			int off = q->items_off;
+			cb(&qp.ids[off], &qp.xs[off], &qp.ys[off], q->items_len, data);
+			continue;
+		}
+
+		// Last pushed, first visited: the spans come in arena order.
+		for (int i = 3; i >= 0; i--) {
+			stack[stack_len++] = q->children + i;
 		}
 	}
+
+	return visited;
 }
 
-struct QuadPool qp;
+int quad_query_nearest(struct Quad *q, float x, float y, int k, int *out, float *out_d2) {
+	struct SpatialNearest n = {out, out_d2, k, 0};
+	uint32_t stack[QUAD_STACK];
+	int stack_len = 0;
 
-void qt_pool_init(int items_cap) {
+	stack[stack_len++] = q - qp.arr;
+
+	while (stack_len > 0) {
+		q = &qp.arr[stack[--stack_len]];
+
+		if (q->items_len == 0 || quad_distance2(q, x, y) >= spatial_nearest_bound(&n)) {
+			continue;
+		}
+
+		if (q->children == 0) {
+			for (int i = q->items_off; i < q->items_off + q->items_len; i++) {
+				float dx = qp.xs[i] - x;
+				float dy = qp.ys[i] - y;
+				spatial_nearest_push(&n, qp.ids[i], dx * dx + dy * dy);
+			}
+
+			continue;
+		}
+
+		// Visit the closest children first so the bound tightens early, they
+		// are pushed farthest first.
+		uint32_t children[4];
+		float d2[4];
+
+		for (int i = 0; i < 4; i++) {
+			int j = i;
+			float d = quad_distance2(quad_child(q, i), x, y);
+
+			for (; j > 0 && d2[j - 1] < d; j--) {
+				children[j] = children[j - 1];
+				d2[j] = d2[j - 1];
+			}
+
+			children[j] = q->children + i;
+			d2[j] = d;
+		}
+
+		for (int i = 0; i < 4; i++) {
+			stack[stack_len++] = children[i];
+		}
+	}
+
+	return n.len;
+}
+
+static void quad_move_items(int dst, int src, int len) {
+	memmove(&qp.ids[dst], &qp.ids[src], len * sizeof(int));
+	memmove(&qp.xs[dst], &qp.xs[src], len * sizeof(float));
+	memmove(&qp.ys[dst], &qp.ys[src], len * sizeof(float));
+}
+
+static void quad_claim_items(struct Quad *leaf, struct QuadUpdate *u) {
+	for (int i = leaf->items_off; i < leaf->items_off + leaf->items_len; i++) {
+		u->slot_of[qp.ids[i]] = i;
+		u->leaf_of[qp.ids[i]] = leaf;
+	}
+}
+
+static void quad_layout(struct Quad *q, int *cursor, struct QuadUpdate *u, int *leaves_len) {
+	if (q->children == 0) {
+		u->leaves[*leaves_len] = q;
+		u->leaves_off[*leaves_len] = q->items_off;
+		(*leaves_len)++;
+
+		q->items_off = *cursor;
+		q->items_cap = q->items_len + QUAD_SLACK(q->items_len);
+		*cursor += q->items_cap;
+		return;
+	}
+
+	q->items_off = *cursor;
+	for (int i = 0; i < 4; i++) {
+		quad_layout(quad_child(q, i), cursor, u, leaves_len);
+	}
+	q->items_cap = *cursor - q->items_off;
+}
+
+// Lays a freshly built tree out for quad_update(): every leaf gets free
+// slots after its items. Leaves only ever move towards the end of the
+// arena, so they are moved last to first.
+void quad_spread(struct Quad *root, struct QuadUpdate *u) {
+	int cursor = 0;
+	int leaves_len = 0;
+
+	quad_layout(root, &cursor, u, &leaves_len);
+	assert(cursor <= qp.items_cap);
+
+	for (int i = leaves_len - 1; i >= 0; i--) {
+		struct Quad *leaf = u->leaves[i];
+
+		quad_move_items(leaf->items_off, u->leaves_off[i], leaf->items_len);
+		quad_claim_items(leaf, u);
+	}
+
+	qp.packed = false;
+	u->len = root->items_len;
+}
+
+// Splits a leaf in place: its items are partitioned as in quad_build() and
+// its free slots shared between the children.
+static bool quad_split(struct Quad *q, struct QuadUpdate *u) {
+	if (q->lvl == MAX_SUBLEVELS || qp.length + 4 > qp.capacity) {
+		return false;
+	}
+
+	quad_divide(q);
+
+	int slack = q->items_cap - q->items_len;
+	int packed_off[4];
+	int off = q->items_off;
+
+	for (int i = 0; i < 4; i++) {
+		struct Quad *c = quad_child(q, i);
+
+		packed_off[i] = c->items_off;
+		c->items_off = off;
+		c->items_cap = c->items_len + (i < 3 ? slack / 4 : slack - 3 * (slack / 4));
+		off += c->items_cap;
+	}
+
+	for (int i = 3; i >= 0; i--) {
+		struct Quad *c = quad_child(q, i);
+
+		quad_move_items(c->items_off, packed_off[i], c->items_len);
+		quad_claim_items(c, u);
+	}
+
+	return true;
+}
+
+// Packs the items of four leaf children back at the start of their
+// parent's range.
+static void quad_merge(struct Quad *q, struct QuadUpdate *u) {
+	int cursor = q->items_off;
+
+	for (int i = 0; i < 4; i++) {
+		struct Quad *c = quad_child(q, i);
+
+		quad_move_items(cursor, c->items_off, c->items_len);
+		cursor += c->items_len;
+	}
+
+	q->children = 0;
+	quad_claim_items(q, u);
+}
+
+static void quad_collect_leaves(struct Quad *q, struct QuadUpdate *u, int *leaves_len) {
+	if (q->children == 0) {
+		u->leaves[(*leaves_len)++] = q;
+		return;
+	}
+
+	for (int i = 0; i < 4; i++) {
+		quad_collect_leaves(quad_child(q, i), u, leaves_len);
+	}
+}
+
+static void quad_fix_spans(struct Quad *q) {
+	if (q->children == 0) {
+		return;
+	}
+
+	q->items_cap = 0;
+	for (int i = 0; i < 4; i++) {
+		quad_fix_spans(quad_child(q, i));
+		q->items_cap += quad_child(q, i)->items_cap;
+	}
+	q->items_off = quad_child(q, 0)->items_off;
+}
+
+// Shares the free slots of a quad's range out again between its leaves, in
+// proportion to their items, after setting one aside for the leaf in need.
+// The leaves are packed at the start of the range first to last, then
+// spread last to first.
+static void quad_respread(struct Quad *q, struct Quad *needy, struct QuadUpdate *u) {
+	int leaves_len = 0;
+	quad_collect_leaves(q, u, &leaves_len);
+
+	int cursor = q->items_off;
+	for (int i = 0; i < leaves_len; i++) {
+		struct Quad *leaf = u->leaves[i];
+
+		quad_move_items(cursor, leaf->items_off, leaf->items_len);
+		u->leaves_off[i] = cursor;
+		cursor += leaf->items_len;
+	}
+
+	long free = q->items_cap - q->items_len - 1;
+	long weight = q->items_len + leaves_len;
+	int off = q->items_off;
+	int shared = 0;
+
+	for (int i = 0; i < leaves_len; i++) {
+		struct Quad *leaf = u->leaves[i];
+		int share = i < leaves_len - 1 ? free * (leaf->items_len + 1) / weight : free - shared;
+
+		leaf->items_off = off;
+		leaf->items_cap = leaf->items_len + share + (leaf == needy);
+		off += leaf->items_cap;
+		shared += share;
+	}
+
+	for (int i = leaves_len - 1; i >= 0; i--) {
+		quad_move_items(u->leaves[i]->items_off, u->leaves_off[i], u->leaves[i]->items_len);
+		quad_claim_items(u->leaves[i], u);
+	}
+
+	quad_fix_spans(q);
+}
+
+static bool quad_has_leaf_children(struct Quad *q) {
+	for (int i = 0; i < 4; i++) {
+		if (quad_child(q, i)->children != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void quad_remove(struct QuadUpdate *u, int id) {
+	struct Quad *leaf = u->leaf_of[id];
+	int slot = u->slot_of[id];
+	int last = leaf->items_off + leaf->items_len - 1;
+
+	if (slot != last) {
+		qp.ids[slot] = qp.ids[last];
+		qp.xs[slot] = qp.xs[last];
+		qp.ys[slot] = qp.ys[last];
+		u->slot_of[qp.ids[slot]] = slot;
+	}
+
+	for (struct Quad *q = leaf; q != NULL; q = quad_parent(q)) {
+		q->items_len--;
+	}
+
+	struct Quad *parent = quad_parent(leaf);
+	if (parent != NULL && parent->items_len <= QUAD_MERGE && quad_has_leaf_children(parent)) {
+		quad_merge(parent, u);
+	}
+}
+
+static bool quad_add(struct Quad *root, struct QuadUpdate *u, int id, float x, float y) {
+	struct Quad *leaf = quad_search(root, x, y);
+
+	// Borrow free slots from the closest ancestor that has any.
+	if (leaf->items_len == leaf->items_cap) {
+		struct Quad *q = quad_parent(leaf);
+
+		while (q != NULL && q->items_len == q->items_cap) {
+			q = quad_parent(q);
+		}
+
+		if (q == NULL) {
+			return false;
+		}
+
+		quad_respread(q, leaf, u);
+	}
+
+	int slot = leaf->items_off + leaf->items_len;
+	qp.ids[slot] = id;
+	qp.xs[slot] = x;
+	qp.ys[slot] = y;
+	u->slot_of[id] = slot;
+	u->leaf_of[id] = leaf;
+
+	for (struct Quad *q = leaf; q != NULL; q = quad_parent(q)) {
+		q->items_len++;
+	}
+
+	// Merged quads are not given back to the pool, running out of quads
+	// calls for a rebuild as well.
+	if (leaf->items_len > QUAD_SPLIT && leaf->lvl < MAX_SUBLEVELS) {
+		return quad_split(leaf, u);
+	}
+
+	return true;
+}
+
+// Moves the items to their new coordinates. Items that stay in their leaf
+// are updated in place, only the others are taken out and inserted again
+// from the root, splitting and merging the leaves on the way. Returns false
+// when the arena ran out of free slots or the pool out of quads, the tree
+// has to be rebuilt then.
+bool quad_update(struct Quad *root, struct QuadUpdate *u, const float *x, const float *y, int len) {
+	int moved_len = 0;
+
+	for (int i = 0; i < len; i++) {
+		float cx = spatial_clamp(x[i], qp.w);
+		float cy = spatial_clamp(y[i], qp.h);
+
+		if (quad_is_inside(u->leaf_of[i], cx, cy)) {
+			qp.xs[u->slot_of[i]] = cx;
+			qp.ys[u->slot_of[i]] = cy;
+		} else {
+			u->moved[moved_len++] = i;
+		}
+	}
+
+	for (int i = 0; i < moved_len; i++) {
+		int id = u->moved[i];
+
+		quad_remove(u, id);
+		if (!quad_add(root, u, id, spatial_clamp(x[id], qp.w), spatial_clamp(y[id], qp.h))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Quads of a tree subdivided down to MAX_SUBLEVELS everywhere.
+int qt_pool_quads() {
 	int quads_len = 1;
 
 	for (int i = 1; i <= MAX_SUBLEVELS; i++) {
 		quads_len += pow(4, i);
 	}
 
+	return quads_len;
+}
+
+void qt_pool_init(int items_cap) {
+	int quads_len = qt_pool_quads();
+
 	qp.length = 0;
+	qp.capacity = quads_len;
 	qp.arr = calloc(quads_len, sizeof(struct Quad));
 	if (qp.arr == NULL) {
 		fprintf(stderr, "Error while allocating quad pool");
 		abort();
 	}
 
-	for (int i = 0; i < quads_len; i++) {
-		struct Quad *q = &qp.arr[i];
-
-		q->items = calloc(items_cap, sizeof(struct QuadItem));
-		if (q->items == NULL) {
-			fprintf(stderr, "Error while allocating quad items");
-			abort();
-		}
+	qp.items_len = 0;
+	qp.items_cap = items_cap;
+	qp.ids = calloc(items_cap, sizeof(int));
+	qp.xs = calloc(items_cap, sizeof(float));
+	qp.ys = calloc(items_cap, sizeof(float));
+	if (qp.ids == NULL || qp.xs == NULL || qp.ys == NULL) {
+		fprintf(stderr, "Error while allocating quad items");
+		abort();
 	}
 }
 
-struct Quad *qt_pool_get(bool root) {
-	if (root) {
-		qp.length = 0;
+// Empties the pool and returns its root, a leaf spanning w by h.
+struct Quad *qt_pool_root(float w, float h) {
+	qp.length = 1;
+	qp.items_len = 0;
+	qp.packed = true;
+	qp.w = w;
+	qp.h = h;
+
+	for (int i = 0; i <= MAX_SUBLEVELS; i++) {
+		qp.quad_w[i] = ldexpf(w, -i);
+		qp.quad_h[i] = ldexpf(h, -i);
 	}
 
-	return &qp.arr[qp.length++];
+	quad_init(&qp.arr[0], 0, 0, 0);
+	return &qp.arr[0];
 }
 
-void qt_pool_free() {
-	int quads_len = 1;
+// Returns the pool index of the first of four consecutive quads.
+uint32_t qt_pool_children() {
+	assert(qp.length + 4 <= qp.capacity);
 
-	for (int i = 1; i <= MAX_SUBLEVELS; i++) {
-		quads_len += pow(4, i);
-	}
+	qp.length += 4;
+	return qp.length - 4;
+}
 
-	for (int i = 0; i < quads_len; i++) {
-		struct Quad q = qp.arr[i];
-		free(q.items);
-	}
+size_t qt_pool_size() {
+	return qp.capacity * sizeof(struct Quad) + qp.items_cap * (sizeof(int) + 2 * sizeof(float));
+}
 
+void qt_pool_free() {
 	free(qp.arr);
+	free(qp.ids);
+	free(qp.xs);
+	free(qp.ys);
 	qp.length = 0;
+	qp.capacity = 0;
 	qp.arr = NULL;
+	qp.items_len = 0;
+	qp.items_cap = 0;
+	qp.ids = NULL;
+	qp.xs = NULL;
+	qp.ys = NULL;
+}
+
+static struct Quad *qt_root;
+
+static void qt_index_build(const float *x, const float *y, int len, float w, float h, float range) {
+	qt_root = qt_pool_root(w, h);
+
+	for (int i = 0; i < len; i++) {
+		quad_insert(qt_root, i, spatial_clamp(x[i], w), spatial_clamp(y[i], h));
+	}
+
+	quad_build(qt_root);
+}
+
+static int qt_index_query_radius(float x, float y, float r, spatial_query_cb cb, void *data) {
+	return quad_query_radius(qt_root, x, y, r, cb, data);
+}
+
+static int qt_index_query_nearest(float x, float y, int k, int *out, float *out_d2) {
+	return quad_query_nearest(qt_root, x, y, k, out, out_d2);
+}
+
+static void qt_index_stats(struct SpatialStats *stats) {
+	stats->bytes = qt_pool_size();
+	stats->nodes = qp.length;
+	stats->items = qp.items_len;
+}
+
+const struct SpatialIndex quadtree_index = {
+	.name = "quadtree",
+	.init = qt_pool_init,
+	.free = qt_pool_free,
+	.build = qt_index_build,
+	.query_radius = qt_index_query_radius,
+	.query_nearest = qt_index_query_nearest,
+	.stats = qt_index_stats,
+};
+
+// Same tree, but only the boids which left their leaf are moved every step.
+// It is rebuilt from scratch when the item count or the bounds change, when
+// the items are renumbered, or when an update runs out of room.
+static struct QuadUpdate qt_update;
+static bool qt_update_valid;
+
+static void qt_inc_index_init(int items_cap) {
+	int quads = qt_pool_quads();
+
+	qt_pool_init(items_cap + items_cap / 2 + 2 * quads);
+
+	qt_update.len = 0;
+	qt_update.slot_of = calloc(items_cap, sizeof(int));
+	qt_update.leaf_of = calloc(items_cap, sizeof(struct Quad *));
+	qt_update.moved = calloc(items_cap, sizeof(int));
+	qt_update.leaves = calloc(quads, sizeof(struct Quad *));
+	qt_update.leaves_off = calloc(quads, sizeof(int));
+	if (qt_update.slot_of == NULL || qt_update.leaf_of == NULL || qt_update.moved == NULL
+		|| qt_update.leaves == NULL || qt_update.leaves_off == NULL) {
+		fprintf(stderr, "Error while allocating quad update");
+		abort();
+	}
+
+	qt_update_valid = false;
+}
+
+static void qt_inc_index_free() {
+	qt_pool_free();
+
+	free(qt_update.slot_of);
+	free(qt_update.leaf_of);
+	free(qt_update.moved);
+	free(qt_update.leaves);
+	free(qt_update.leaves_off);
+	qt_update.slot_of = NULL;
+	qt_update.leaf_of = NULL;
+	qt_update.moved = NULL;
+	qt_update.leaves = NULL;
+	qt_update.leaves_off = NULL;
+	qt_update_valid = false;
+}
+
+static void qt_inc_index_build(const float *x, const float *y, int len, float w, float h, float range) {
+	if (qt_update_valid && len == qt_update.len && qp.w == w && qp.h == h
+		&& quad_update(qt_root, &qt_update, x, y, len)) {
+		return;
+	}
+
+	qt_index_build(x, y, len, w, h, range);
+	quad_spread(qt_root, &qt_update);
+	qt_update_valid = true;
+}
+
+static void qt_inc_index_invalidate() {
+	qt_update_valid = false;
+}
+
+static void qt_inc_index_stats(struct SpatialStats *stats) {
+	qt_index_stats(stats);
+	stats->bytes += qt_update.len * (sizeof(int) * 2 + sizeof(struct Quad *))
+		+ qp.capacity * (sizeof(struct Quad *) + sizeof(int));
 }
 
+const struct SpatialIndex quadtree_inc_index = {
+	.name = "quadtree-inc",
+	.init = qt_inc_index_init,
+	.free = qt_inc_index_free,
+	.build = qt_inc_index_build,
+	.invalidate = qt_inc_index_invalidate,
+	.query_radius = qt_index_query_radius,
+	.query_nearest = qt_index_query_nearest,
+	.stats = qt_inc_index_stats,
+};
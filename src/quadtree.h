@@ -2,44 +2,102 @@
 #define QUADTREE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "spatial.h"
 
 #define MAX_SUBLEVELS 6
+#define QUAD_CAPACITY 4
 
-struct QuadItem {
-	void *item;
-	float x;
-	float y;
-};
+// Incremental updates split a leaf once it holds more than QUAD_SPLIT items
+// and merge a quad back into a leaf once it holds QUAD_MERGE items or less,
+// the gap keeps a boid going back and forth from flipping a node.
+#define QUAD_SPLIT (2 * QUAD_CAPACITY)
+#define QUAD_MERGE (QUAD_CAPACITY / 2)
 
-struct Quad {
-	struct QuadItem *items;
-	struct Quad *children[4];
+// Free slots left after the items of every leaf when laid out for updates.
+#define QUAD_SLACK(len) ((len) / 2 + 2)
 
-	int lvl;
+// Marks the root's parent.
+#define QUAD_NONE UINT32_MAX
 
-	int items_len;
+// Quads are kept small so that the top of the tree stays in cache. They
+// refer to each other by pool index, and the four children of a quad are
+// allocated next to each other, top left, top right, bottom left, bottom
+// right, which is also the order of their ranges in the arena. The bounds
+// are not stored: a quad of level lvl is the cell (col, row) of the 2^lvl
+// by 2^lvl grid laid over the root.
+struct Quad {
+	// Pool index of the first child, 0 for a leaf since the root is never
+	// a child.
+	uint32_t children;
+	uint32_t parent;
 
-	bool subdivided;
+	// Range of this quad's items in the pool arena. A subdivided quad's
+	// range spans the ranges of all of its children. Once laid out for
+	// updates, a leaf owns items_cap slots of which its items fill the first
+	// items_len, and a subdivided quad's items_len is the count of its
+	// subtree.
+	int items_off;
+	int items_len;
+	int items_cap;
 
-	float x;
-	float y;
-	float w;
-	float h;
+	uint8_t lvl;
+	uint8_t col;
+	uint8_t row;
 };
 
-void quad_init(struct Quad *q, float x, float y, float w, float h, int lvl);
-void quad_insert(struct Quad *q, void *item, float x, float y);
+void quad_init(struct Quad *q, int lvl, int col, int row);
+void quad_insert(struct Quad *q, int id, float x, float y);
+void quad_build(struct Quad *q);
 bool quad_is_inside(struct Quad *q, float x, float y);
 struct Quad *quad_search(struct Quad *q, float x, float y);
+int quad_query_radius(struct Quad *q, float x, float y, float r, spatial_query_cb cb, void *data);
+int quad_query_nearest(struct Quad *q, float x, float y, int k, int *out, float *out_d2);
 
 struct QuadPool {
 	struct Quad *arr;
 	int length;
+	int capacity;
+
+	// Bounds of the root and size of a quad of every level.
+	float w;
+	float h;
+	float quad_w[MAX_SUBLEVELS + 1];
+	float quad_h[MAX_SUBLEVELS + 1];
+
+	// Item arena, every item is stored as its id and its coordinates.
+	int *ids;
+	float *xs;
+	float *ys;
+	int items_len;
+	int items_cap;
+
+	// Cleared once the leaves are laid out with free slots in between, a
+	// subdivided quad's range is then no longer one span of items.
+	bool packed;
+};
+
+// Where every item lives, kept up to date by quad_update().
+struct QuadUpdate {
+	int *slot_of;
+	struct Quad **leaf_of;
+	int *moved;
+	int len;
+
+	// Scratch space of quad_spread(), one entry per pool quad.
+	struct Quad **leaves;
+	int *leaves_off;
 };
 
+void quad_spread(struct Quad *root, struct QuadUpdate *u);
+bool quad_update(struct Quad *root, struct QuadUpdate *u, const float *x, const float *y, int len);
 
 void qt_pool_init(int items_cap);
-struct Quad *qt_pool_get(bool root);
+int qt_pool_quads();
+struct Quad *qt_pool_root(float w, float h);
+uint32_t qt_pool_children();
+size_t qt_pool_size();
 void qt_pool_free();
 
 #endif
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ringbuf.h"
+
+#define RINGBUF_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+void ringbuf_init(struct RingBuffer *rb, size_t region_size) {
+	rb->region_size = region_size;
+	rb->region = 0;
+
+	for (int i = 0; i < RINGBUF_REGIONS; i++) {
+		rb->fences[i] = NULL;
+	}
+
+	glGenBuffers(1, &rb->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, rb->vbo);
+	glBufferStorage(GL_ARRAY_BUFFER, region_size * RINGBUF_REGIONS, NULL, RINGBUF_FLAGS);
+
+	rb->ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, region_size * RINGBUF_REGIONS, RINGBUF_FLAGS);
+	if (rb->ptr == NULL) {
+		fprintf(stderr, "Error while mapping ring buffer");
+		abort();
+	}
+}
+
+// Returns the region to write this frame, waiting for the GPU to be done
+// with it if it was used RINGBUF_REGIONS frames ago and is still in flight.
+void *ringbuf_begin(struct RingBuffer *rb) {
+	GLsync fence = rb->fences[rb->region];
+
+	if (fence != NULL) {
+		GLenum status;
+
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+
+		glDeleteSync(fence);
+		rb->fences[rb->region] = NULL;
+	}
+
+	return rb->ptr + ringbuf_offset(rb);
+}
+
+size_t ringbuf_offset(struct RingBuffer *rb) {
+	return rb->region * rb->region_size;
+}
+
+// Must be called after the commands reading the current region have been
+// issued.
+void ringbuf_end(struct RingBuffer *rb) {
+	rb->fences[rb->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	rb->region = (rb->region + 1) % RINGBUF_REGIONS;
+}
+
+void ringbuf_free(struct RingBuffer *rb) {
+	for (int i = 0; i < RINGBUF_REGIONS; i++) {
+		if (rb->fences[i] != NULL) {
+			glDeleteSync(rb->fences[i]);
+			rb->fences[i] = NULL;
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, rb->vbo);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glDeleteBuffers(1, &rb->vbo);
+
+	rb->ptr = NULL;
+	rb->vbo = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+#include <stddef.h>
+#include <glad/gl.h>
+
+#define RINGBUF_REGIONS 3
+
+// A persistently and coherently mapped buffer split in regions which are
+// written in turn, one per frame. Each region is guarded by a fence so the
+// CPU never writes into a region the GPU may still be reading.
+struct RingBuffer {
+	GLuint vbo;
+	char *ptr;
+
+	size_t region_size;
+	int region;
+
+	GLsync fences[RINGBUF_REGIONS];
+};
+
+void ringbuf_init(struct RingBuffer *rb, size_t region_size);
+void *ringbuf_begin(struct RingBuffer *rb);
+size_t ringbuf_offset(struct RingBuffer *rb);
+void ringbuf_end(struct RingBuffer *rb);
+void ringbuf_free(struct RingBuffer *rb);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Draws per boid per step. A draw is addressed by the boid, the step and
+// the draw index, so every number can be generated on any thread in any
+// order and still come out the same for a given seed.
+#define RNG_DRAWS_PER_STEP 4
+
+// Widynski's Squares counter-based generator: four rounds of squaring of
+// the counter times the key.
+static inline uint32_t rng_squares(uint64_t ctr, uint64_t key) {
+	uint64_t x = ctr * key;
+	uint64_t y = x;
+	uint64_t z = y + key;
+
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+	x = x * x + z;
+	x = (x >> 32) | (x << 32);
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+
+	return (x * x + z) >> 32;
+}
+
+// Spreads the seed over all the bits of the key with splitmix64. Squares
+// keys should be odd and have their bits well mixed.
+static inline uint64_t rng_key(uint64_t seed) {
+	uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	z = z ^ (z >> 31);
+
+	return z | 1;
+}
+
+static inline uint64_t rng_counter(uint32_t id, uint32_t step, uint32_t draw) {
+	return ((uint64_t)(step * RNG_DRAWS_PER_STEP + draw) << 32) | id;
+}
+
+// Uniform in [0, 1).
+static inline float rng_float(uint64_t key, uint32_t id, uint32_t step, uint32_t draw) {
+	return (rng_squares(rng_counter(id, step, draw), key) >> 8) * 0x1p-24f;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include <math.h>
+#include <sys/resource.h>
+#include "profiler.h"
+#include "scaling.h"
+#include "sim.h"
+#include "workers.h"
+
+static long scaling_peak_rss_kb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_maxrss;
+}
+
+static double scaling_step_ns(const struct SpatialIndex *index, int len, int threads, int steps) {
+	struct Sim sim = {.params = sim_default_params};
+
+	// The world grows with the boid count so every boid sees about as many
+	// neighbors as with the default count in the default window.
+	float side = sqrtf(sim.params.width * sim.params.height * len / SCALING_DENSITY_BOIDS);
+	sim.params.width = side;
+	sim.params.height = side;
+
+	workers_init(threads);
+	sim_init(&sim, len, index);
+	sim_spawn(&sim, side / 2, side / 2, side / 2, SCALING_SEED);
+
+	// The first step touches the freshly allocated states for the first time
+	// and builds every index from scratch, it is left out of the timing.
+	sim_step(&sim);
+
+	uint64_t start = prof_now();
+	for (int i = 0; i < steps; i++) {
+		sim_step(&sim);
+	}
+	uint64_t elapsed = prof_now() - start;
+
+	sim_free(&sim);
+	workers_free();
+
+	return (double)elapsed / steps;
+}
+
+static int scaling_next_threads(int threads, int max_threads) {
+	if (threads == max_threads) {
+		return max_threads + 1;
+	}
+
+	return threads * 2 < max_threads ? threads * 2 : max_threads;
+}
+
+// Sweeps the boid counts by powers of ten and the worker counts by powers of
+// two up to max_threads, then max_threads itself. Parallel efficiency is
+// relative to the single threaded run of the same boid count. Peak RSS is the
+// peak of the whole process so far, boid counts only grow along the sweep so
+// it is the peak of the largest run.
+void scaling_run(FILE *out, const struct SpatialIndex *index, int max_threads, int steps) {
+	fprintf(out, "index,boids,threads,steps,ns_per_boid_step,efficiency,peak_rss_kb\n");
+
+	for (int len = SCALING_MIN_BOIDS; len <= SCALING_MAX_BOIDS; len *= 10) {
+		double single_ns = 0;
+
+		for (int threads = 1; threads <= max_threads; threads = scaling_next_threads(threads, max_threads)) {
+			double ns = scaling_step_ns(index, len, threads, steps);
+
+			if (threads == 1) {
+				single_ns = ns;
+			}
+
+			fprintf(out, "%s,%d,%d,%d,%.2f,%.3f,%ld\n", index->name, len, threads, steps,
+				ns / len, single_ns / (ns * threads), scaling_peak_rss_kb());
+			fflush(out);
+		}
+	}
+}
@@ -0,0 +1,15 @@
+#ifndef SCALING_H
+#define SCALING_H
+
+#include <stdio.h>
+#include "spatial.h"
+
+// Boids per default window, the density every run of the sweep is held at.
+#define SCALING_DENSITY_BOIDS 5000
+#define SCALING_MIN_BOIDS 1000
+#define SCALING_MAX_BOIDS 1000000
+#define SCALING_SEED 1
+
+void scaling_run(FILE *out, const struct SpatialIndex *index, int max_threads, int steps);
+
+#endif
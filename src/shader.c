@@ -117,6 +117,10 @@ void shader_set_vec4(Shader s, const char* name, vec4 v) {
 	glUniform4fv(glGetUniformLocation(s, name), 1, v);
 }
 
+void shader_set_vec4v(Shader s, const char* name, int count, vec4 *v) {
+	glUniform4fv(glGetUniformLocation(s, name), count, (float*)v);
+}
+
 void shader_set_4f(Shader s, const char* name, float x, float y, float z, float w) {
 	glUniform4f(glGetUniformLocation(s, name), x, y, z, w);
 }
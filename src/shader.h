@@ -20,6 +20,7 @@ void shader_set_vec3(Shader s, const char *name, vec3 v);
 void shader_set_3f(Shader s, const char *name, float x, float y, float z);
 
 void shader_set_vec4(Shader s, const char *name, vec4 v);
+void shader_set_vec4v(Shader s, const char *name, int count, vec4 *v);
 void shader_set_4f(Shader s, const char *name, float x, float y, float z, float w);
 
 void shader_set_mat2(Shader s, const char *name, mat2 m);
@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include "kernels.h"
+#include "pairs.h"
+#include "profiler.h"
+#include "rng.h"
+#include "sim.h"
+#include "workers.h"
+
+const struct SimParams sim_default_params = {
+	.width = 1280.0f,
+	.height = 720.0f,
+
+	.protected_range = 8.0f,
+	.visible_range = 40.0f,
+	.seperation_fct = 0.05f,
+	.alignment_fct = 0.05f,
+	.cohesion_fct = 0.0005f,
+	.turn_fct = 0.2f,
+	.max_speed = 6.0f,
+	.min_speed = 3.0f,
+	.max_bias = 0.01f,
+	.bias_increment = 0.00004f,
+};
+
+// Applies the flocking rules and the edge turns to boid i given its
+// neighborhood. The resulting velocity is written to the back state for
+// sim_integrate_chunk() to finish.
+static void sim_steer(struct Sim *sim, int i, const struct Neighborhood *n) {
+	const struct SimParams *p = &sim->params;
+	struct BoidState *front = &sim->states[sim->front];
+	struct BoidState *back = &sim->states[sim->back];
+
+	float x = front->x[i];
+	float y = front->y[i];
+	float vx = front->vx[i];
+	float vy = front->vy[i];
+
+	if (n->visible_count > 0) {
+		float avg_x = n->avg_x / n->visible_count;
+		float avg_y = n->avg_y / n->visible_count;
+		float avg_vx = n->avg_vx / n->visible_count;
+		float avg_vy = n->avg_vy / n->visible_count;
+
+		vx += (avg_x - x) * p->cohesion_fct + (avg_vx - vx) * p->alignment_fct;
+		vy += (avg_y - y) * p->cohesion_fct + (avg_vy - vy) * p->alignment_fct;
+	}
+
+	vx += n->close_dx * p->seperation_fct;
+	vy += n->close_dy * p->seperation_fct;
+
+	if (y < 100) {
+		vy += p->turn_fct;
+	} else if (y > p->height - 100) {
+		vy -= p->turn_fct;
+	}
+
+	if (x < 100) {
+		vx += p->turn_fct;
+	} else if (x > p->width - 100) {
+		vx -= p->turn_fct;
+	}
+
+	back->vx[i] = vx;
+	back->vy[i] = vy;
+}
+
+// Sums up the neighbors of boid i found through the spatial index.
+static void sim_neighborhood(struct Sim *sim, int i, struct Neighborhood *n) {
+	const struct SimParams *p = &sim->params;
+	struct BoidState *front = &sim->states[sim->front];
+
+	*n = (struct Neighborhood){
+		.vx = front->vx,
+		.vy = front->vy,
+		.x = spatial_clamp(front->x[i], p->width),
+		.y = spatial_clamp(front->y[i], p->height),
+		.visible2 = p->visible_range * p->visible_range,
+		.protected2 = p->protected_range * p->protected_range,
+	};
+	sim->index->query_radius(n->x, n->y, p->visible_range, kernels.neighbors, n);
+}
+
+static void sim_neighbors_chunk(int begin, int end, int worker, void *data) {
+	struct Sim *sim = data;
+
+	for (int i = begin; i < end; i++) {
+		struct Neighborhood n;
+
+		sim_neighborhood(sim, i, &n);
+		sim_steer(sim, i, &n);
+	}
+}
+
+// Runs over the pair grid slots, which hold the boids in cell order.
+static void sim_pairs_chunk(int begin, int end, int worker, void *data) {
+	struct Sim *sim = data;
+
+	for (int slot = begin; slot < end; slot++) {
+		struct Neighborhood n;
+
+		pairs_neighborhood(sim->pairs, slot, &n);
+		sim_steer(sim, sim->pairs->grid.ids[slot], &n);
+	}
+}
+
+// The pair pass is allocated on the first use.
+static struct Pairs *sim_pairs(struct Sim *sim) {
+	if (sim->pairs == NULL) {
+		sim->pairs = malloc(sizeof(struct Pairs));
+		if (sim->pairs == NULL) {
+			fprintf(stderr, "Error while allocating memory");
+			abort();
+		}
+		pairs_init(sim->pairs, sim->len);
+	}
+
+	return sim->pairs;
+}
+
+// Applies the group bias and the speed limits, then moves the boids.
+static void sim_integrate_chunk(int begin, int end, int worker, void *data) {
+	struct Sim *sim = data;
+	const struct SimParams *p = &sim->params;
+	struct BoidState *front = &sim->states[sim->front];
+	struct BoidState *back = &sim->states[sim->back];
+
+	kernels.integrate(p, front, back, sim->group, begin, end);
+}
+
+static void sim_init_state(struct BoidState *state, int len) {
+	state->x = calloc(len, sizeof(float));
+	state->y = calloc(len, sizeof(float));
+	state->vx = calloc(len, sizeof(float));
+	state->vy = calloc(len, sizeof(float));
+	state->bias = calloc(len, sizeof(float));
+	if (state->x == NULL || state->y == NULL || state->vx == NULL || state->vy == NULL || state->bias == NULL) {
+		fprintf(stderr, "Error while allocating memory");
+		abort();
+	}
+}
+
+static void sim_free_state(struct BoidState *state) {
+	free(state->x);
+	free(state->y);
+	free(state->vx);
+	free(state->vy);
+	free(state->bias);
+}
+
+// The parameters are left alone so they survive a re-initialization with
+// a different boid count.
+void sim_init(struct Sim *sim, int len, const struct SpatialIndex *index) {
+	sim->len = len;
+	sim->front = 0;
+	sim->prev = 1;
+	sim->pinned[0] = -1;
+	sim->pinned[1] = -1;
+
+	for (int i = 0; i < SIM_STATES; i++) {
+		sim_init_state(&sim->states[i], len);
+	}
+
+	sim->group = calloc(len, sizeof(uint8_t));
+	sim->id = calloc(len, sizeof(int));
+	sim->slot = calloc(len, sizeof(int));
+	sim->sorted_group = calloc(len, sizeof(uint8_t));
+	sim->sorted_id = calloc(len, sizeof(int));
+	if (sim->group == NULL || sim->id == NULL || sim->slot == NULL || sim->sorted_group == NULL || sim->sorted_id == NULL) {
+		fprintf(stderr, "Error while allocating memory");
+		abort();
+	}
+
+	morton_init(&sim->sort, len);
+
+	sim->index = index;
+	sim->index->init(len);
+
+	kernels_init();
+}
+
+struct Spawn {
+	struct Sim *sim;
+	float x;
+	float y;
+	float spread;
+};
+
+static void sim_spawn_chunk(int begin, int end, int worker, void *data) {
+	struct Spawn *sp = data;
+	struct BoidState *front = sim_front(sp->sim);
+	struct BoidState *prev = sim_prev(sp->sim);
+	uint64_t key = sp->sim->key;
+
+	for (int i = begin; i < end; i++) {
+		sp->sim->group[i] = i % 4;
+		sp->sim->id[i] = i;
+		sp->sim->slot[i] = i;
+
+		front->bias[i] = 0.001;
+		front->vx[i] = 0;
+		front->vy[i] = 0;
+
+		front->x[i] = sp->x + sp->spread * (rng_float(key, i, 0, 0) * 2.0f - 1.0f);
+		front->y[i] = sp->y + sp->spread * (rng_float(key, i, 0, 1) * 2.0f - 1.0f);
+
+		// Start with no motion to interpolate over.
+		prev->x[i] = front->x[i];
+		prev->y[i] = front->y[i];
+		prev->vx[i] = 0;
+		prev->vy[i] = 0;
+		prev->bias[i] = front->bias[i];
+	}
+}
+
+// Every random number is derived from the seed, the boid and the step, so a
+// seed always spawns and runs the same flock whatever the number of workers.
+void sim_spawn(struct Sim *sim, float x, float y, float spread, uint64_t seed) {
+	struct Spawn sp = {sim, x, y, spread};
+
+	sim->key = rng_key(seed);
+	sim->step = 0;
+	sim->order++;
+	workers_run(sim->len, 0, sim_spawn_chunk, &sp);
+}
+
+void sim_set_index(struct Sim *sim, const struct SpatialIndex *index) {
+	if (sim->index == index) {
+		return;
+	}
+
+	sim->index->free();
+	sim->index = index;
+	sim->index->init(sim->len);
+}
+
+// Without pins this ping-pongs between the first two states.
+static int sim_next_back(struct Sim *sim) {
+	for (int i = 0; i < SIM_STATES; i++) {
+		if (i != sim->front && i != sim->pinned[0] && i != sim->pinned[1]) {
+			return i;
+		}
+	}
+
+	abort();
+}
+
+struct Sort {
+	struct Sim *sim;
+	const int *order;
+	const struct BoidState *src;
+	struct BoidState *dst;
+};
+
+static void sim_sort_chunk(int begin, int end, int worker, void *data) {
+	struct Sort *so = data;
+	struct Sim *sim = so->sim;
+
+	for (int i = begin; i < end; i++) {
+		int j = so->order[i];
+
+		so->dst->x[i] = so->src->x[j];
+		so->dst->y[i] = so->src->y[j];
+		so->dst->vx[i] = so->src->vx[j];
+		so->dst->vy[i] = so->src->vy[j];
+		so->dst->bias[i] = so->src->bias[j];
+
+		sim->sorted_group[i] = sim->group[j];
+		sim->sorted_id[i] = sim->id[j];
+		sim->slot[sim->id[j]] = i;
+	}
+}
+
+// Moves the boids to the slots of their position along a Z-order curve, so
+// that boids close in space are close in memory. The front is copied in
+// sorted order into a free state, which becomes the front, the pinned
+// states are left as they are.
+static void sim_sort(struct Sim *sim) {
+	struct SimParams *p = &sim->params;
+	struct BoidState *front = sim_front(sim);
+	int sorted = sim_next_back(sim);
+	struct Sort so = {
+		.sim = sim,
+		.order = morton_sort(&sim->sort, front->x, front->y, sim->len, p->width, p->height),
+		.src = front,
+		.dst = &sim->states[sorted],
+	};
+
+	workers_run(sim->len, 0, sim_sort_chunk, &so);
+
+	uint8_t *group = sim->group;
+	sim->group = sim->sorted_group;
+	sim->sorted_group = group;
+
+	int *id = sim->id;
+	sim->id = sim->sorted_id;
+	sim->sorted_id = id;
+
+	sim->front = sorted;
+	sim->order++;
+
+	if (sim->index->invalidate != NULL) {
+		sim->index->invalidate();
+	}
+}
+
+void sim_step(struct Sim *sim) {
+	struct SimParams *p = &sim->params;
+
+	if (sim->step % SIM_SORT_STEPS == 0) {
+		PROF_BEGIN(PROF_SORT);
+		sim_sort(sim);
+		PROF_END(PROF_SORT);
+	}
+
+	struct BoidState *front = sim_front(sim);
+	sim->back = sim_next_back(sim);
+
+	if (sim->pairwise) {
+		PROF_BEGIN(PROF_INDEX_BUILD);
+		pairs_build(sim_pairs(sim), front, sim->len, p->width, p->height, p->visible_range);
+		PROF_END(PROF_INDEX_BUILD);
+
+		PROF_BEGIN(PROF_NEIGHBORS);
+		pairs_run(sim->pairs, p->visible_range * p->visible_range, p->protected_range * p->protected_range);
+		workers_run(sim->len, 0, sim_pairs_chunk, sim);
+		PROF_END(PROF_NEIGHBORS);
+	} else {
+		PROF_BEGIN(PROF_INDEX_BUILD);
+		sim->index->build(front->x, front->y, sim->len, p->width, p->height, p->visible_range);
+		PROF_END(PROF_INDEX_BUILD);
+
+		PROF_BEGIN(PROF_NEIGHBORS);
+		workers_run(sim->len, 0, sim_neighbors_chunk, sim);
+		PROF_END(PROF_NEIGHBORS);
+	}
+
+	PROF_BEGIN(PROF_INTEGRATE);
+	workers_run(sim->len, 0, sim_integrate_chunk, sim);
+	PROF_END(PROF_INTEGRATE);
+
+	sim->prev = sim->front;
+	sim->front = sim->back;
+	sim->step++;
+}
+
+struct Check {
+	struct Sim *sim;
+
+	// Every boid as one span, for the brute-force search.
+	int *ids;
+	float *xs;
+	float *ys;
+
+	bool *differs;
+};
+
+// The sums are added up in a different order by the brute-force search, only
+// the counts have to match exactly.
+static bool sim_check_sum(float got, float want) {
+	return fabsf(got - want) <= 1e-3f * (fabsf(got) + fabsf(want) + 1);
+}
+
+static bool sim_check_neighborhood(const struct Neighborhood *got, const struct Neighborhood *want) {
+	return got->visible_count == want->visible_count
+		&& sim_check_sum(got->close_dx, want->close_dx) && sim_check_sum(got->close_dy, want->close_dy)
+		&& sim_check_sum(got->avg_x, want->avg_x) && sim_check_sum(got->avg_y, want->avg_y)
+		&& sim_check_sum(got->avg_vx, want->avg_vx) && sim_check_sum(got->avg_vy, want->avg_vy);
+}
+
+// Runs over the pair grid slots in pairwise mode, over the boids otherwise.
+static void sim_check_chunk(int begin, int end, int worker, void *data) {
+	struct Check *c = data;
+	struct Sim *sim = c->sim;
+	const struct SimParams *p = &sim->params;
+	struct BoidState *front = sim_front(sim);
+
+	for (int k = begin; k < end; k++) {
+		struct Neighborhood got;
+		int i = k;
+
+		if (sim->pairwise) {
+			pairs_neighborhood(sim->pairs, k, &got);
+			i = sim->pairs->grid.ids[k];
+		} else {
+			sim_neighborhood(sim, k, &got);
+		}
+
+		struct Neighborhood want = {
+			.vx = front->vx,
+			.vy = front->vy,
+			.x = c->xs[i],
+			.y = c->ys[i],
+			.visible2 = p->visible_range * p->visible_range,
+			.protected2 = p->protected_range * p->protected_range,
+		};
+		kernels_neighbors_scalar(c->ids, c->xs, c->ys, sim->len, &want);
+
+		c->differs[i] = !sim_check_neighborhood(&got, &want);
+	}
+}
+
+// Compares the neighborhood every boid of the front gets from the current
+// search, the spatial index or the pair pass, with the scalar kernel run
+// over all the boids. Returns the number of boids whose neighborhoods
+// differ. Quadratic in the boid count, it is meant for checking runs.
+int sim_check_neighbors(struct Sim *sim) {
+	const struct SimParams *p = &sim->params;
+	struct BoidState *front = sim_front(sim);
+	struct Check c = {
+		.sim = sim,
+		.ids = calloc(sim->len, sizeof(int)),
+		.xs = calloc(sim->len, sizeof(float)),
+		.ys = calloc(sim->len, sizeof(float)),
+		.differs = calloc(sim->len, sizeof(bool)),
+	};
+	if (c.ids == NULL || c.xs == NULL || c.ys == NULL || c.differs == NULL) {
+		fprintf(stderr, "Error while allocating memory");
+		abort();
+	}
+
+	for (int i = 0; i < sim->len; i++) {
+		c.ids[i] = i;
+		c.xs[i] = spatial_clamp(front->x[i], p->width);
+		c.ys[i] = spatial_clamp(front->y[i], p->height);
+	}
+
+	if (sim->pairwise) {
+		pairs_build(sim_pairs(sim), front, sim->len, p->width, p->height, p->visible_range);
+		pairs_run(sim->pairs, p->visible_range * p->visible_range, p->protected_range * p->protected_range);
+	} else {
+		sim->index->build(front->x, front->y, sim->len, p->width, p->height, p->visible_range);
+	}
+
+	workers_run(sim->len, 0, sim_check_chunk, &c);
+
+	int differs = 0;
+	for (int i = 0; i < sim->len; i++) {
+		differs += c.differs[i];
+	}
+
+	free(c.ids);
+	free(c.xs);
+	free(c.ys);
+	free(c.differs);
+
+	return differs;
+}
+
+struct BoidState *sim_front(struct Sim *sim) {
+	return &sim->states[sim->front];
+}
+
+// The state the front was stepped from.
+struct BoidState *sim_prev(struct Sim *sim) {
+	return &sim->states[sim->prev];
+}
+
+// Must not be called while a step is running. The pins hold until the next
+// call.
+void sim_pin(struct Sim *sim) {
+	sim->pinned[0] = sim->prev;
+	sim->pinned[1] = sim->front;
+}
+
+void sim_free(struct Sim *sim) {
+	for (int i = 0; i < SIM_STATES; i++) {
+		sim_free_state(&sim->states[i]);
+	}
+
+	free(sim->group);
+	free(sim->id);
+	free(sim->slot);
+	free(sim->sorted_group);
+	free(sim->sorted_id);
+	morton_free(&sim->sort);
+	sim->index->free();
+
+	if (sim->pairs != NULL) {
+		pairs_free(sim->pairs);
+		free(sim->pairs);
+		sim->pairs = NULL;
+	}
+
+	sim->group = NULL;
+	sim->id = NULL;
+	sim->slot = NULL;
+	sim->sorted_group = NULL;
+	sim->sorted_id = NULL;
+	sim->len = 0;
+}
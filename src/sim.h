@@ -0,0 +1,110 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "morton.h"
+#include "spatial.h"
+
+struct Pairs;
+
+// Speeds and factors are per step, a step stands for 1 / SIM_STEP_RATE
+// seconds of simulated time.
+#define SIM_STEP_RATE 60
+
+// Boids drift away from the boids next to them in memory as they move, they
+// are sorted again along a Z-order curve every SIM_SORT_STEPS steps.
+#define SIM_SORT_STEPS 60
+
+enum Group {
+	RIGHT = 0,
+	LEFT,
+	BOTTOM,
+	TOP,
+};
+
+struct SimParams {
+	float width;
+	float height;
+
+	float protected_range;
+	float visible_range;
+	float seperation_fct;
+	float alignment_fct;
+	float cohesion_fct;
+	float turn_fct;
+	float max_speed;
+	float min_speed;
+	float max_bias;
+	float bias_increment;
+};
+
+struct BoidState {
+	float *x;
+	float *y;
+	float *vx;
+	float *vy;
+	float *bias;
+};
+
+// Enough states for a renderer to hold on to the last two while steps keep
+// going in the other two.
+#define SIM_STATES 4
+
+// A step reads only the front state and writes only the back state, then
+// the back becomes the front and the old front the prev state. Every boid
+// sees the same snapshot of the previous step, whatever order or thread it
+// is updated in.
+//
+// sim_pin() keeps the current prev and front states from being written by
+// the following steps, so they can be read while the simulation runs ahead.
+struct Sim {
+	struct SimParams params;
+	const struct SpatialIndex *index;
+
+	struct BoidState states[SIM_STATES];
+	int front;
+	int prev;
+	int back;
+	int pinned[2];
+
+	// Slots are the positions in the state arrays and change with every
+	// sort, ids are the positions at the spawn and never change. id maps a
+	// slot to its id and slot an id to its slot. order is bumped whenever
+	// the slots change, so that per boid data kept outside of the states,
+	// like the group colors on the GPU, can be refreshed.
+	uint8_t *group;
+	int *id;
+	int *slot;
+	uint32_t order;
+	int len;
+
+	struct MortonSort sort;
+	uint8_t *sorted_group;
+	int *sorted_id;
+
+	// Finds the neighbors with the pair pass instead of the spatial index.
+	// Like the parameters it survives a re-initialization, its buffers are
+	// allocated on the first step that needs them.
+	bool pairwise;
+	struct Pairs *pairs;
+
+	// Key of the random generator and the number of steps since the spawn,
+	// random draws are addressed by boid and step.
+	uint64_t key;
+	uint32_t step;
+};
+
+extern const struct SimParams sim_default_params;
+
+void sim_init(struct Sim *sim, int len, const struct SpatialIndex *index);
+void sim_spawn(struct Sim *sim, float x, float y, float spread, uint64_t seed);
+void sim_set_index(struct Sim *sim, const struct SpatialIndex *index);
+void sim_step(struct Sim *sim);
+int sim_check_neighbors(struct Sim *sim);
+struct BoidState *sim_front(struct Sim *sim);
+struct BoidState *sim_prev(struct Sim *sim);
+void sim_pin(struct Sim *sim);
+void sim_free(struct Sim *sim);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "simjob.h"
+
+static void *simjob_main(void *arg) {
+	struct SimJob *job = arg;
+
+	pthread_mutex_lock(&job->lock);
+
+	while (true) {
+		while (!job->busy && !job->quit) {
+			pthread_cond_wait(&job->start, &job->lock);
+		}
+
+		if (job->quit) {
+			break;
+		}
+
+		int steps = job->steps;
+		pthread_mutex_unlock(&job->lock);
+
+		for (int i = 0; i < steps; i++) {
+			sim_step(job->sim);
+		}
+
+		pthread_mutex_lock(&job->lock);
+		job->busy = false;
+		pthread_cond_signal(&job->done);
+	}
+
+	pthread_mutex_unlock(&job->lock);
+	return NULL;
+}
+
+void simjob_init(struct SimJob *job, struct Sim *sim) {
+	job->sim = sim;
+	job->steps = 0;
+	job->busy = false;
+	job->quit = false;
+
+	pthread_mutex_init(&job->lock, NULL);
+	pthread_cond_init(&job->start, NULL);
+	pthread_cond_init(&job->done, NULL);
+
+	if (pthread_create(&job->thread, NULL, simjob_main, job) != 0) {
+		fprintf(stderr, "Error while creating simulation thread");
+		abort();
+	}
+}
+
+// The simulation must not be touched until simjob_wait() returns, except
+// for reading the states pinned with sim_pin() before the start.
+void simjob_start(struct SimJob *job, int steps) {
+	if (steps <= 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&job->lock);
+	job->steps = steps;
+	job->busy = true;
+	pthread_cond_signal(&job->start);
+	pthread_mutex_unlock(&job->lock);
+}
+
+void simjob_wait(struct SimJob *job) {
+	pthread_mutex_lock(&job->lock);
+	while (job->busy) {
+		pthread_cond_wait(&job->done, &job->lock);
+	}
+	pthread_mutex_unlock(&job->lock);
+}
+
+void simjob_free(struct SimJob *job) {
+	simjob_wait(job);
+
+	pthread_mutex_lock(&job->lock);
+	job->quit = true;
+	pthread_cond_signal(&job->start);
+	pthread_mutex_unlock(&job->lock);
+
+	pthread_join(job->thread, NULL);
+	pthread_mutex_destroy(&job->lock);
+	pthread_cond_destroy(&job->start);
+	pthread_cond_destroy(&job->done);
+}
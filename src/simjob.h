@@ -0,0 +1,29 @@
+#ifndef SIMJOB_H
+#define SIMJOB_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "sim.h"
+
+// Runs steps of a simulation on a thread of its own, which drives the
+// worker pool as its worker 0, so the calling thread is free to render
+// the states pinned before the steps were started.
+struct SimJob {
+	struct Sim *sim;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+
+	int steps;
+	bool busy;
+	bool quit;
+};
+
+void simjob_init(struct SimJob *job, struct Sim *sim);
+void simjob_start(struct SimJob *job, int steps);
+void simjob_wait(struct SimJob *job);
+void simjob_free(struct SimJob *job);
+
+#endif
@@ -0,0 +1,50 @@
+#include <math.h>
+#include <string.h>
+#include "spatial.h"
+
+const struct SpatialIndex *spatial_indices[] = {
+	&quadtree_index,
+	&quadtree_inc_index,
+	&grid_index,
+};
+
+const int spatial_indices_len = sizeof(spatial_indices) / sizeof(spatial_indices[0]);
+
+const struct SpatialIndex *spatial_find(const char *name) {
+	for (int i = 0; i < spatial_indices_len; i++) {
+		if (strcmp(spatial_indices[i]->name, name) == 0) {
+			return spatial_indices[i];
+		}
+	}
+
+	return NULL;
+}
+
+float spatial_clamp(float v, float max) {
+	return fminf(fmaxf(0, v), max - 1);
+}
+
+// Keeps the k closest items seen so far sorted by distance.
+void spatial_nearest_push(struct SpatialNearest *n, int id, float d2) {
+	if (d2 >= spatial_nearest_bound(n)) {
+		return;
+	}
+
+	int i = n->len < n->k ? n->len++ : n->k - 1;
+
+	for (; i > 0 && n->d2[i - 1] > d2; i--) {
+		n->ids[i] = n->ids[i - 1];
+		n->d2[i] = n->d2[i - 1];
+	}
+
+	n->ids[i] = id;
+	n->d2[i] = d2;
+}
+
+float spatial_nearest_bound(struct SpatialNearest *n) {
+	if (n->k == 0) {
+		return 0;
+	}
+
+	return n->len < n->k ? INFINITY : n->d2[n->k - 1];
+}
@@ -0,0 +1,60 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <stddef.h>
+
+// Candidates are reported in spans of the index's own arrays: the ids of
+// the items and their coordinates as stored in the index.
+typedef void (*spatial_query_cb)(const int *ids, const float *xs, const float *ys, int len, void *data);
+
+struct SpatialStats {
+	size_t bytes;
+	int nodes;
+	int items;
+};
+
+// A spatial index is rebuilt from scratch every step from the coordinate
+// arrays, item i gets id i. Coordinates are clamped into the w by h bounds.
+// query_radius() reports candidate spans which may hold items outside the
+// circle and returns the number of nodes or cells it visited,
+// query_nearest() returns the ids of up to k items sorted by
+// distance. An index keeping state from one build to the next drops it on
+// invalidate(), so that the next build starts from scratch. It is called
+// when the items are renumbered and may be NULL for the others.
+struct SpatialIndex {
+	const char *name;
+
+	void (*init)(int items_cap);
+	void (*free)();
+
+	void (*build)(const float *x, const float *y, int len, float w, float h, float range);
+	void (*invalidate)();
+
+	int (*query_radius)(float x, float y, float r, spatial_query_cb cb, void *data);
+	int (*query_nearest)(float x, float y, int k, int *out, float *out_d2);
+
+	void (*stats)(struct SpatialStats *stats);
+};
+
+extern const struct SpatialIndex quadtree_index;
+extern const struct SpatialIndex quadtree_inc_index;
+extern const struct SpatialIndex grid_index;
+
+extern const struct SpatialIndex *spatial_indices[];
+extern const int spatial_indices_len;
+
+const struct SpatialIndex *spatial_find(const char *name);
+
+struct SpatialNearest {
+	int *ids;
+	float *d2;
+	int k;
+	int len;
+};
+
+float spatial_clamp(float v, float max);
+
+void spatial_nearest_push(struct SpatialNearest *n, int id, float d2);
+float spatial_nearest_bound(struct SpatialNearest *n);
+
+#endif
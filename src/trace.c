@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "profiler.h"
+#include "trace.h"
+
+struct Trace {
+	FILE *file;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct TraceBuffer *buffers;
+	int buffers_len;
+	int session;
+	uint64_t start;
+	bool first;
+	_Atomic bool enabled;
+	_Atomic bool quit;
+	_Atomic int dropped;
+};
+
+struct Trace tr;
+
+// The session is kept next to the buffer so a thread that outlived a
+// previous trace does not reuse its freed buffer.
+static _Thread_local struct TraceBuffer *trace_local;
+static _Thread_local int trace_local_session;
+
+static void trace_write(struct TraceBuffer *b, struct TraceEvent *e) {
+	fprintf(tr.file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+		tr.first ? "" : ",", e->name, b->tid, (e->begin - tr.start) / 1e3, (e->end - e->begin) / 1e3);
+
+	if (e->arg_begin >= 0) {
+		fprintf(tr.file, ",\"args\":{\"begin\":%d,\"end\":%d}", e->arg_begin, e->arg_end);
+	}
+
+	fputc('}', tr.file);
+	tr.first = false;
+}
+
+static void trace_drain() {
+	pthread_mutex_lock(&tr.lock);
+
+	for (struct TraceBuffer *b = tr.buffers; b != NULL; b = b->next) {
+		uint32_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+		uint32_t tail = atomic_load_explicit(&b->tail, memory_order_relaxed);
+
+		for (; tail != head; tail++) {
+			trace_write(b, &b->events[tail % TRACE_BUFFER_EVENTS]);
+		}
+
+		atomic_store_explicit(&b->tail, tail, memory_order_release);
+	}
+
+	pthread_mutex_unlock(&tr.lock);
+}
+
+static void *trace_main(void *arg) {
+	struct timespec interval = {0, TRACE_FLUSH_INTERVAL_MS * 1000000L};
+
+	while (!atomic_load_explicit(&tr.quit, memory_order_relaxed)) {
+		nanosleep(&interval, NULL);
+		trace_drain();
+	}
+
+	return NULL;
+}
+
+// Starts recording Chrome trace events to path. The file is written by a
+// background thread, so recording threads never touch it.
+bool trace_open(const char *path) {
+	tr.file = fopen(path, "w");
+	if (tr.file == NULL) {
+		return false;
+	}
+
+	pthread_mutex_init(&tr.lock, NULL);
+	tr.buffers = NULL;
+	tr.buffers_len = 0;
+	tr.session++;
+	tr.start = prof_now();
+	tr.first = true;
+	atomic_store(&tr.quit, false);
+	atomic_store(&tr.dropped, 0);
+
+	fprintf(tr.file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	if (pthread_create(&tr.thread, NULL, trace_main, NULL) != 0) {
+		fprintf(stderr, "Error while creating trace thread");
+		abort();
+	}
+
+	atomic_store(&tr.enabled, true);
+	return true;
+}
+
+bool trace_enabled() {
+	return atomic_load_explicit(&tr.enabled, memory_order_relaxed);
+}
+
+static struct TraceBuffer *trace_buffer() {
+	if (trace_local != NULL && trace_local_session == tr.session) {
+		return trace_local;
+	}
+
+	struct TraceBuffer *b = calloc(1, sizeof(struct TraceBuffer));
+	if (b != NULL) {
+		b->events = calloc(TRACE_BUFFER_EVENTS, sizeof(struct TraceEvent));
+	}
+	if (b == NULL || b->events == NULL) {
+		fprintf(stderr, "Error while allocating trace buffer");
+		abort();
+	}
+
+	pthread_mutex_lock(&tr.lock);
+	b->tid = tr.buffers_len++;
+	b->next = tr.buffers;
+	tr.buffers = b;
+	pthread_mutex_unlock(&tr.lock);
+
+	trace_local = b;
+	trace_local_session = tr.session;
+	return b;
+}
+
+// Records a complete event on the calling thread. arg_begin and arg_end
+// are attached as the item range of a worker chunk unless arg_begin is -1.
+void trace_event(const char *name, uint64_t begin, uint64_t end, int arg_begin, int arg_end) {
+	if (!trace_enabled()) {
+		return;
+	}
+
+	struct TraceBuffer *b = trace_buffer();
+	uint32_t head = atomic_load_explicit(&b->head, memory_order_relaxed);
+
+	if (head - atomic_load_explicit(&b->tail, memory_order_acquire) >= TRACE_BUFFER_EVENTS) {
+		atomic_fetch_add_explicit(&tr.dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	b->events[head % TRACE_BUFFER_EVENTS] = (struct TraceEvent){name, begin, end, arg_begin, arg_end};
+	atomic_store_explicit(&b->head, head + 1, memory_order_release);
+}
+
+// Must only be called once no other thread is recording anymore.
+void trace_close() {
+	if (!trace_enabled()) {
+		return;
+	}
+
+	atomic_store(&tr.enabled, false);
+	atomic_store(&tr.quit, true);
+	pthread_join(tr.thread, NULL);
+	trace_drain();
+
+	fprintf(tr.file, "\n]}\n");
+	fclose(tr.file);
+
+	int dropped = atomic_load(&tr.dropped);
+	if (dropped > 0) {
+		fprintf(stderr, "trace: dropped %d events\n", dropped);
+	}
+
+	while (tr.buffers != NULL) {
+		struct TraceBuffer *next = tr.buffers->next;
+		free(tr.buffers->events);
+		free(tr.buffers);
+		tr.buffers = next;
+	}
+
+	pthread_mutex_destroy(&tr.lock);
+	tr.file = NULL;
+}
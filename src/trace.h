@@ -0,0 +1,35 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Events a thread can record before the flush thread catches up. Events
+// recorded into a full buffer are dropped and counted instead of blocking.
+#define TRACE_BUFFER_EVENTS 65536
+#define TRACE_FLUSH_INTERVAL_MS 10
+
+struct TraceEvent {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+	int arg_begin;
+	int arg_end;
+};
+
+// Single producer, single consumer ring. Only the owning thread advances
+// head and only the flush thread advances tail.
+struct TraceBuffer {
+	struct TraceEvent *events;
+	_Atomic uint32_t head;
+	_Atomic uint32_t tail;
+	int tid;
+	struct TraceBuffer *next;
+};
+
+bool trace_open(const char *path);
+bool trace_enabled();
+void trace_event(const char *name, uint64_t begin, uint64_t end, int arg_begin, int arg_end);
+void trace_close();
+
+#endif
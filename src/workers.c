@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "profiler.h"
+#include "trace.h"
+#include "workers.h"
+
+#define WORKERS_CHUNKS_PER_WORKER 16
+#define WORKERS_MIN_CHUNK 64
+
+struct Workers {
+	pthread_t *threads;
+	struct WorkerQueue *queues;
+	int len;
+
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	int generation;
+	int busy;
+	bool quit;
+
+	workers_fn fn;
+	void *data;
+	int items_len;
+	int chunk;
+};
+
+struct Workers wp;
+
+static void workers_call(workers_fn fn, int begin, int end, int worker, void *data) {
+#ifdef BOIDS_PROFILE
+	if (trace_enabled()) {
+		uint64_t start = prof_now();
+		fn(begin, end, worker, data);
+		trace_event("Chunk", start, prof_now(), begin, end);
+		return;
+	}
+#endif
+
+	fn(begin, end, worker, data);
+}
+
+static bool workers_pop(int queue, int *chunk) {
+	struct WorkerQueue *q = &wp.queues[queue];
+
+	if (atomic_load_explicit(&q->next, memory_order_relaxed) >= q->end) {
+		return false;
+	}
+
+	*chunk = atomic_fetch_add_explicit(&q->next, 1, memory_order_relaxed);
+	return *chunk < q->end;
+}
+
+static void workers_drain(int worker) {
+	int chunk;
+
+	for (int i = 0; i < wp.len; i++) {
+		int queue = (worker + i) % wp.len;
+
+		while (workers_pop(queue, &chunk)) {
+			int begin = chunk * wp.chunk;
+			int end = begin + wp.chunk < wp.items_len ? begin + wp.chunk : wp.items_len;
+
+			workers_call(wp.fn, begin, end, worker, wp.data);
+		}
+	}
+}
+
+static void *workers_main(void *arg) {
+	int worker = (int)(long)arg;
+	int seen = 0;
+
+	while (true) {
+		pthread_mutex_lock(&wp.lock);
+		while (wp.generation == seen && !wp.quit) {
+			pthread_cond_wait(&wp.start, &wp.lock);
+		}
+
+		seen = wp.generation;
+		if (wp.quit) {
+			pthread_mutex_unlock(&wp.lock);
+			break;
+		}
+		pthread_mutex_unlock(&wp.lock);
+
+		workers_drain(worker);
+
+		pthread_mutex_lock(&wp.lock);
+		if (--wp.busy == 0) {
+			pthread_cond_signal(&wp.done);
+		}
+		pthread_mutex_unlock(&wp.lock);
+	}
+
+	return NULL;
+}
+
+// The calling thread counts as worker 0, so only threads - 1 threads are
+// spawned.
+void workers_init(int threads) {
+	wp.len = threads < 1 ? 1 : threads;
+	wp.generation = 0;
+	wp.busy = 0;
+	wp.quit = false;
+
+	wp.threads = calloc(wp.len, sizeof(pthread_t));
+	wp.queues = aligned_alloc(64, wp.len * sizeof(struct WorkerQueue));
+	if (wp.threads == NULL || wp.queues == NULL) {
+		fprintf(stderr, "Error while allocating workers");
+		abort();
+	}
+
+	pthread_mutex_init(&wp.lock, NULL);
+	pthread_cond_init(&wp.start, NULL);
+	pthread_cond_init(&wp.done, NULL);
+
+	for (int i = 1; i < wp.len; i++) {
+		if (pthread_create(&wp.threads[i], NULL, workers_main, (void *)(long)i) != 0) {
+			fprintf(stderr, "Error while creating worker thread");
+			abort();
+		}
+	}
+}
+
+int workers_count() {
+	return wp.len;
+}
+
+int workers_default_count() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n < 1 ? 1 : n;
+}
+
+// Runs fn over [0, len) split in chunks of the given size and returns once
+// every chunk is done. A chunk size of 0 picks one that gives every worker
+// several chunks, so a worker stuck on a dense region gets its remaining
+// chunks stolen instead of leaving the others idle.
+void workers_run(int len, int chunk, workers_fn fn, void *data) {
+	if (len <= 0) {
+		return;
+	}
+
+	if (chunk <= 0) {
+		chunk = len / (wp.len * WORKERS_CHUNKS_PER_WORKER);
+		chunk = chunk < WORKERS_MIN_CHUNK ? WORKERS_MIN_CHUNK : chunk;
+	}
+
+	if (wp.len == 1) {
+		for (int begin = 0; begin < len; begin += chunk) {
+			workers_call(fn, begin, begin + chunk < len ? begin + chunk : len, 0, data);
+		}
+		return;
+	}
+
+	int chunks = (len + chunk - 1) / chunk;
+
+	wp.fn = fn;
+	wp.data = data;
+	wp.items_len = len;
+	wp.chunk = chunk;
+
+	for (int i = 0; i < wp.len; i++) {
+		atomic_store_explicit(&wp.queues[i].next, (long)chunks * i / wp.len, memory_order_relaxed);
+		wp.queues[i].end = (long)chunks * (i + 1) / wp.len;
+	}
+
+	pthread_mutex_lock(&wp.lock);
+	wp.generation++;
+	wp.busy = wp.len - 1;
+	pthread_cond_broadcast(&wp.start);
+	pthread_mutex_unlock(&wp.lock);
+
+	workers_drain(0);
+
+	pthread_mutex_lock(&wp.lock);
+	while (wp.busy > 0) {
+		pthread_cond_wait(&wp.done, &wp.lock);
+	}
+	pthread_mutex_unlock(&wp.lock);
+}
+
+void workers_free() {
+	pthread_mutex_lock(&wp.lock);
+	wp.quit = true;
+	pthread_cond_broadcast(&wp.start);
+	pthread_mutex_unlock(&wp.lock);
+
+	for (int i = 1; i < wp.len; i++) {
+		pthread_join(wp.threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&wp.lock);
+	pthread_cond_destroy(&wp.start);
+	pthread_cond_destroy(&wp.done);
+
+	free(wp.threads);
+	free(wp.queues);
+	wp.threads = NULL;
+	wp.queues = NULL;
+	wp.len = 0;
+}
@@ -0,0 +1,21 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+typedef void (*workers_fn)(int begin, int end, int worker, void *data);
+
+// One chunk queue per worker, padded so the cursors do not share a cache
+// line. Worker w starts on its own share of the chunks and steals from the
+// others once it runs dry.
+struct WorkerQueue {
+	_Atomic int next;
+	int end;
+	char pad[56];
+};
+
+void workers_init(int threads);
+int workers_count();
+int workers_default_count();
+void workers_run(int len, int chunk, workers_fn fn, void *data);
+void workers_free();
+
+#endif